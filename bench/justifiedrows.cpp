@@ -0,0 +1,60 @@
+/*
+ * Copyright 2014  Giulio Camuffo <giuliocamuffo@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "justifiedrows.h"
+
+/*
+ * Lays out 500 windows of random sizes on a 1920x1080 area, as the scale
+ * effect does with every window open, and prints the time per layout.
+ * Exits with 1 if it takes 1 ms or more.
+ */
+
+static const int Windows = 500;
+static const int Runs = 200;
+// Keeps the result alive so the layout isn't optimized away
+static volatile int s_sink;
+
+static double now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000. + ts.tv_nsec / 1000000.;
+}
+
+int main(int argc, char **argv)
+{
+    srand(0);
+    std::vector<IVector2D> sizes;
+    for (int i = 0; i < Windows; ++i) {
+        sizes.push_back(IVector2D(200 + rand() % 1500, 150 + rand() % 900));
+    }
+    IRect2D area(0, 32, 1920, 1048);
+
+    double start = now();
+    for (int i = 0; i < Runs; ++i) {
+        s_sink += justifiedRows(area, sizes).back().y;
+    }
+    double elapsed = (now() - start) / Runs;
+
+    printf("justifiedRows: %d windows in %.3f ms\n", Windows, elapsed);
+    return elapsed < 1. ? 0 : 1;
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright 2014  Giulio Camuffo <giuliocamuffo@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <vector>
+
+#include "workspacedamage.h"
+
+/*
+ * Switches between two workspaces of 50 windows of random sizes on a
+ * 1920x1080 output, damaging them once per view, as Layer::show() and
+ * hide() do, and once per workspace, as Workspace::damage() does, and
+ * prints the time per switch. Exits with 1 if damaging the outputs
+ * covered by a background is not faster than damaging each view.
+ */
+
+static const int Windows = 50;
+static const int Runs = 2000;
+// Keeps the result alive so the damage isn't optimized away
+static volatile int s_sink;
+
+static double now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000. + ts.tv_nsec / 1000000.;
+}
+
+static std::vector<pixman_region32_t> createWorkspace()
+{
+    std::vector<pixman_region32_t> views(Windows);
+    for (pixman_region32_t &view: views) {
+        int w = 200 + rand() % 1200;
+        int h = 150 + rand() % 700;
+        pixman_region32_init_rect(&view, rand() % (1920 - w), rand() % (1080 - h), w, h);
+    }
+    return views;
+}
+
+int main(int argc, char **argv)
+{
+    srand(0);
+    std::vector<pixman_region32_t> workspaces[2] = { createWorkspace(), createWorkspace() };
+    pixman_region32_t output, background, damage;
+    pixman_region32_init_rect(&output, 0, 0, 1920, 1080);
+    pixman_region32_init_rect(&background, 0, 0, 1920, 1080);
+    pixman_region32_init(&damage);
+
+    // Per view: the views of the old and new workspace, each on its own
+    double start = now();
+    for (int i = 0; i < Runs; ++i) {
+        pixman_region32_fini(&damage);
+        pixman_region32_init(&damage);
+        for (const std::vector<pixman_region32_t> &ws: workspaces) {
+            for (const pixman_region32_t &view: ws) {
+                pixman_region32_union(&damage, &damage, const_cast<pixman_region32_t *>(&view));
+            }
+        }
+        s_sink += pixman_region32_n_rects(&damage);
+    }
+    double perView = (now() - start) / Runs;
+
+    // Per workspace, with a background covering the output
+    start = now();
+    for (int i = 0; i < Runs; ++i) {
+        pixman_region32_fini(&damage);
+        pixman_region32_init(&damage);
+        for (int j = 0; j < 2; ++j) {
+            if (pixman_region32_contains_rectangle(&background, pixman_region32_extents(&output)) == PIXMAN_REGION_IN) {
+                pixman_region32_union(&damage, &damage, &output);
+            }
+        }
+        s_sink += pixman_region32_n_rects(&damage);
+    }
+    double covered = (now() - start) / Runs;
+
+    // Per workspace, without a background
+    start = now();
+    for (int i = 0; i < Runs; ++i) {
+        pixman_region32_fini(&damage);
+        pixman_region32_init(&damage);
+        for (const std::vector<pixman_region32_t> &ws: workspaces) {
+            WorkspaceDamage wsDamage;
+            for (const pixman_region32_t &view: ws) {
+                wsDamage.addBox(*pixman_region32_extents(const_cast<pixman_region32_t *>(&view)));
+            }
+            pixman_region32_t partial;
+            pixman_region32_init(&partial);
+            if (wsDamage.forOutput(&output, &partial) != WorkspaceDamage::Output::None) {
+                pixman_region32_union(&damage, &damage, &partial);
+            }
+            pixman_region32_fini(&partial);
+        }
+        s_sink += pixman_region32_n_rects(&damage);
+    }
+    double partial = (now() - start) / Runs;
+
+    printf("workspace switch, %d windows per workspace:\n", Windows);
+    printf("  per view:                       %.4f ms\n", perView);
+    printf("  per workspace, with background: %.4f ms\n", covered);
+    printf("  per workspace, no background:   %.4f ms\n", partial);
+
+    for (std::vector<pixman_region32_t> &ws: workspaces) {
+        for (pixman_region32_t &view: ws) {
+            pixman_region32_fini(&view);
+        }
+    }
+    pixman_region32_fini(&output);
+    pixman_region32_fini(&background);
+    pixman_region32_fini(&damage);
+    return covered < perView ? 0 : 1;
+}
@@ -18,8 +18,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <linux/input.h>
 
+#include <algorithm>
+
 #include <wayland-server.h>
 
 #include <weston/compositor.h>
@@ -40,6 +43,7 @@
 #include "xwlshell.h"
 #include "desktopshellwindow.h"
 #include "desktopshellworkspace.h"
+#include "windowtable.h"
 #include "animation.h"
 #include "settings.h"
 #include "settingsinterface.h"
@@ -113,12 +117,28 @@ struct Client {
     WlListener destroyListener;
 };
 
+/*
+ * The shell client is killed if it doesn't answer a ping in time. The timeout
+ * adapts to the latency measured on the recent pings, so that a client that
+ * is just slow under load is not mistaken for a dead one.
+ */
+static const int MinPingTimeout = 500;
+static const int MaxPingTimeout = 5000;
+static const uint32_t MinPingSamples = 8;
+// The latency summary is logged at most this often, if there were pongs
+static const int PingReportInterval = 60000;
+
 DesktopShell::DesktopShell(struct weston_compositor *ec)
             : Shell(ec)
             , m_sessionManager(nullptr)
-            , m_pingTimer(500)
+            , m_pingTimer(MinPingTimeout)
+            , m_pingSerial(0)
+            , m_pingTime(0)
+            , m_pingReportTimer(PingReportInterval)
+            , m_windowFilterMode(DESKTOP_SHELL_WINDOW_FILTER_ALL)
 {
     m_pingTimer.triggered.connect(this, &DesktopShell::pingTimerTimeout);
+    m_pingReportTimer.triggered.connect(this, &DesktopShell::reportPingLatency);
 }
 
 DesktopShell::~DesktopShell()
@@ -136,31 +156,14 @@ DesktopShell::~DesktopShell()
     delete m_nextWsBinding;
     delete m_quitBinding;
 
-    if (m_sessionManager) {
-        std::list<pid_t> pids;
-        for (ShellSurface *s: surfaces()) {
-            WlShellSurface *w = s->findInterface<WlShellSurface>();
-            if (w) {
-                wl_client *c = wl_resource_get_client(w->resource());
-                pid_t pid;
-                wl_client_get_credentials(c, &pid, nullptr, nullptr);
-                pids.push_back(pid);
-            }
-        }
-        for (wl_client *c: findInterface<Dropdown>()->boundClients()) {
-            pid_t pid;
-            wl_client_get_credentials(c, &pid, nullptr, nullptr);
-            pids.push_back(pid);
-        }
-        m_sessionManager->save(pids);
-    }
+    delete m_sessionManager;
 }
 
 void DesktopShell::init()
 {
     Shell::init();
 
-    if (!wl_global_create(compositor()->wl_display, &desktop_shell_interface, 1, this,
+    if (!wl_global_create(compositor()->wl_display, &desktop_shell_interface, 2, this,
         [](struct wl_client *client, void *data, uint32_t version, uint32_t id) { static_cast<DesktopShell *>(data)->bind(client, version, id); }))
         return;
 
@@ -170,6 +173,11 @@ void DesktopShell::init()
         shseat->pointerMotionSignal.connect(this, &DesktopShell::pointerMotion);
     }
 
+    currentWorkspaceChangedSignal.connect(this, &DesktopShell::updateWindowScopes);
+    windowsAreaChangedSignal.connect(this, &DesktopShell::windowsAreaChanged);
+    gameModeChangedSignal.connect(this, &DesktopShell::gameModeChanged);
+    workspaceRemovedSignal.connect(this, &DesktopShell::workspaceRemoved);
+
     m_moveBinding = new Binding();
     m_moveBinding->buttonTriggered.connect(this, &DesktopShell::moveBinding);
     m_resizeBinding = new Binding();
@@ -198,7 +206,11 @@ void DesktopShell::init()
     addInterface(wls);
     addInterface(new XWlShell);
     addInterface(new SettingsInterface);
-    addInterface(new Dropdown);
+    Dropdown *dropdown = new Dropdown;
+    if (m_sessionManager) {
+        dropdown->boundSignal.connect(m_sessionManager, &SessionManager::addClient);
+    }
+    addInterface(dropdown);
     XdgShell *xdg = new XdgShell;
     xdg->surfaceResponsivenessChangedSignal.connect(this, &DesktopShell::surfaceResponsivenessChanged);
     addInterface(xdg);
@@ -267,7 +279,7 @@ void DesktopShell::endBusyCursor(struct weston_seat *seat)
 
 bool DesktopShell::isTrusted(wl_client *client, const char *interface) const
 {
-    if (client == m_child.client) {
+    if (Shell::isTrusted(client, interface)) {
         return true;
     }
 
@@ -302,21 +314,33 @@ void DesktopShell::trustedClientDestroyed(void *data)
 
 void DesktopShell::pointerMotion(ShellSeat *seat, weston_pointer *pointer)
 {
-    if (!m_child.desktop_shell || m_pingTimer.isRunning()) {
+    if (!m_child.desktop_shell || m_pingTimer.isRunning() || isInGameMode()) {
         return;
     }
 
     wl_display *display = wl_client_get_display(shellClient());
     m_pingSerial = wl_display_next_serial(display);
+    m_pingTime = LatencyHistogram::now();
     m_pingTimer.start();
 
     desktop_shell_send_ping(m_child.desktop_shell, m_pingSerial);
     wl_client_flush(shellClient());
 }
 
+void DesktopShell::gameModeChanged(bool gameMode)
+{
+    if (gameMode) {
+        // The shell client may not get much CPU time now, don't kill it for that
+        m_pingTimer.stop();
+    } else {
+        DesktopShellWindow::flushAll();
+    }
+}
+
 void DesktopShell::pingTimerTimeout()
 {
-    printf("The shell client is unresponsive, restarting it...\n");
+    weston_log("The shell client is unresponsive after %dms, restarting it...\n", m_pingTimer.interval());
+    weston_log("shell client ping latency: %s\n", m_pingLatency.toString().c_str());
     m_pingTimer.stop();
     wl_client_destroy(m_child.client);
 }
@@ -330,10 +354,14 @@ void DesktopShell::sendInitEvents()
         workspaceAdded(dws);
     }
 
-    for (ShellSurface *shsurf: surfaces()) {
-        DesktopShellWindow *w = shsurf->findInterface<DesktopShellWindow>();
-        if (w) {
-            w->create();
+    if (wl_resource_get_version(m_child.desktop_shell) >= 2) {
+        sendWindowTable();
+    } else {
+        for (ShellSurface *shsurf: surfaces()) {
+            DesktopShellWindow *w = shsurf->findInterface<DesktopShellWindow>();
+            if (w && w->isInScope()) {
+                w->create();
+            }
         }
     }
 
@@ -352,6 +380,33 @@ void DesktopShell::sendInitEvents()
     }
 }
 
+void DesktopShell::sendWindowTable()
+{
+    WindowTable table(wl_display_next_serial(compositor()->wl_display));
+    for (ShellSurface *shsurf: surfaces()) {
+        DesktopShellWindow *w = shsurf->findInterface<DesktopShellWindow>();
+        if (w && w->isInScope()) {
+            w->addToTable(&table);
+        }
+    }
+
+    size_t size;
+    int fd = table.createFile(&size);
+    if (fd < 0) {
+        // fall back to announcing every window on its own
+        for (ShellSurface *shsurf: surfaces()) {
+            DesktopShellWindow *w = shsurf->findInterface<DesktopShellWindow>();
+            if (w && w->isInScope()) {
+                w->create();
+            }
+        }
+        return;
+    }
+
+    desktop_shell_send_window_table(m_child.desktop_shell, fd, size);
+    close(fd);
+}
+
 void DesktopShell::workspaceAdded(DesktopShellWorkspace *ws)
 {
     desktop_shell_send_workspace_added(m_child.desktop_shell, ws->resource(), ws->workspace()->isActive());
@@ -375,9 +430,19 @@ void DesktopShell::bind(struct wl_client *client, uint32_t version, uint32_t id)
         wl_resource_set_implementation(resource, &m_desktop_shell_implementation, this,
                                        [](struct wl_resource *resource) { static_cast<DesktopShell *>(wl_resource_get_user_data(resource))->unbind(resource); });
         m_child.desktop_shell = resource;
+        activateShellClient();
+        return;
+    }
 
-        sendInitEvents();
-        desktop_shell_send_load(resource);
+    if (client && client == m_standby.client) {
+        // The standby instance stays dormant, waiting for the load event. Until
+        // it is promoted it must not change anything, so any request is an error.
+        wl_resource_set_dispatcher(resource, [](const void *, void *target, uint32_t, const wl_message *msg, wl_argument *) {
+            wl_resource *res = static_cast<wl_resource *>(target);
+            wl_resource_post_error(res, DESKTOP_SHELL_ERROR_NOT_ACTIVE, "%s sent by the standby instance before load", msg->name);
+            return 0;
+        }, nullptr, this, [](struct wl_resource *resource) { static_cast<DesktopShell *>(wl_resource_get_user_data(resource))->unbind(resource); });
+        m_standby.desktop_shell = resource;
         return;
     }
 
@@ -385,6 +450,26 @@ void DesktopShell::bind(struct wl_client *client, uint32_t version, uint32_t id)
     wl_resource_destroy(resource);
 }
 
+void DesktopShell::activateShellClient()
+{
+    // A new process, its latency has nothing to do with the old one's
+    m_pingTimer.stop();
+    m_pingLatency.resetRecent();
+    m_pingTimer.setInterval(MinPingTimeout);
+
+    sendInitEvents();
+    desktop_shell_send_load(m_child.desktop_shell);
+}
+
+void DesktopShell::shellClientPromoted()
+{
+    wl_resource_set_implementation(m_child.desktop_shell, &m_desktop_shell_implementation, this,
+                                   [](struct wl_resource *resource) { static_cast<DesktopShell *>(wl_resource_get_user_data(resource))->unbind(resource); });
+    // The old instance's resource may still be around, don't let its state leak
+    resetClientState();
+    activateShellClient();
+}
+
 void DesktopShell::bindSplash(wl_client *client, uint32_t version, uint32_t id)
 {
     wl_resource *resource = wl_resource_create(client, &desktop_shell_splash_interface, version, id);
@@ -400,7 +485,37 @@ void DesktopShell::bindSplash(wl_client *client, uint32_t version, uint32_t id)
 
 void DesktopShell::unbind(struct wl_resource *resource)
 {
+    if (resource == m_standby.desktop_shell) {
+        m_standby.desktop_shell = nullptr;
+        return;
+    }
+    // The resource of a dead client may go away after the standby took over
+    if (resource != m_child.desktop_shell) {
+        return;
+    }
+
     m_child.desktop_shell = nullptr;
+    resetClientState();
+}
+
+void DesktopShell::resetClientState()
+{
+    m_windowFilterMode = DESKTOP_SHELL_WINDOW_FILTER_ALL;
+    m_windowFilterWorkspaces.clear();
+    DesktopShellWindow::resetTable();
+}
+
+void DesktopShell::updateWindowScopes()
+{
+    if (!m_child.desktop_shell) {
+        return;
+    }
+
+    for (ShellSurface *shsurf: surfaces()) {
+        if (DesktopShellWindow *w = shsurf->findInterface<DesktopShellWindow>()) {
+            w->updateScope();
+        }
+    }
 }
 
 void DesktopShell::moveBinding(struct weston_seat *seat, uint32_t time, uint32_t button)
@@ -627,17 +742,15 @@ void DesktopShell::setPanel(wl_client *client, wl_resource *resource, uint32_t i
     desktop_shell_send_configure(resource, 0, surface_resource, surface->output->width, surface->output->height);
 }
 
-void DesktopShell::panelConfigure(weston_surface *es, int32_t sx, int32_t sy, Shell::PanelPosition pos)
+void DesktopShell::windowsAreaChanged(weston_output *output)
 {
-    Shell::panelConfigure(es, sx, sy, pos);
-
-    if (es->width == 0) {
+    if (!m_child.desktop_shell) {
         return;
     }
 
-    IRect2D rect = windowsArea(es->output);
+    IRect2D rect = windowsArea(output);
     for (Output &out: m_outputs) {
-        if (out.output == es->output && out.rect != rect) {
+        if (out.output == output && out.rect != rect) {
             out.rect = rect;
             desktop_shell_send_desktop_rect(m_child.desktop_shell, out.resource, rect.x, rect.y, rect.width, rect.height);
         }
@@ -964,6 +1077,159 @@ void DesktopShell::pong(uint32_t serial)
 
     if (m_pingSerial == serial) {
         m_pingTimer.stop();
+        m_pingLatency.addSample(LatencyHistogram::now() - m_pingTime);
+        updatePingTimeout();
+        if (!m_pingReportTimer.isRunning()) {
+            m_pingReportTimer.start();
+        }
+    }
+}
+
+void DesktopShell::reportPingLatency()
+{
+    m_pingReportTimer.stop();
+    weston_log("shell client ping latency: %s timeout %dms\n", m_pingLatency.toString().c_str(), m_pingTimer.interval());
+    if (m_child.desktop_shell && wl_resource_get_version(m_child.desktop_shell) >= 2 && m_pingLatency.count() > 0) {
+        desktop_shell_send_ping_stats(m_child.desktop_shell, m_pingLatency.count(), m_pingLatency.min(), m_pingLatency.max(),
+                                      m_pingLatency.mean(), m_pingLatency.percentile(0.5), m_pingLatency.percentile(0.99),
+                                      m_pingTimer.interval());
+    }
+}
+
+void DesktopShell::updatePingTimeout()
+{
+    if (m_pingLatency.recentCount() < MinPingSamples) {
+        return;
+    }
+
+    // Leave plenty of room over the worst recent round trips
+    int timeout = 4 * m_pingLatency.percentile(0.99);
+    m_pingTimer.setInterval(std::min(std::max(timeout, MinPingTimeout), MaxPingTimeout));
+}
+
+void DesktopShell::getWindow(wl_client *client, wl_resource *resource, uint32_t id, uint32_t window)
+{
+    DesktopShellWindow *w = DesktopShellWindow::fromId(window);
+    if (w && w->isInTable()) {
+        w->createFromTable(client, wl_resource_get_version(resource), id);
+        return;
+    }
+
+    // The window is gone, or the client already has an object for it.
+    wl_resource *res = wl_resource_create(client, &desktop_shell_window_interface, wl_resource_get_version(resource), id);
+    desktop_shell_window_send_removed(res);
+    wl_resource_destroy(res);
+}
+
+void DesktopShell::setWindowFilter(wl_client *client, wl_resource *resource, uint32_t mode, wl_array *workspaces)
+{
+    std::vector<Workspace *> list;
+    if (mode == DESKTOP_SHELL_WINDOW_FILTER_WORKSPACES) {
+        int32_t *id;
+        wl_array_for_each(id, workspaces) {
+            if (*id < 0) {
+                wl_resource_post_error(resource, DESKTOP_SHELL_ERROR_INVALID_FILTER, "invalid workspace %d in the window filter", *id);
+                return;
+            }
+            if (Workspace *ws = workspace(*id)) {
+                list.push_back(ws);
+            }
+        }
+    } else if (mode != DESKTOP_SHELL_WINDOW_FILTER_ALL && mode != DESKTOP_SHELL_WINDOW_FILTER_CURRENT_WORKSPACE) {
+        wl_resource_post_error(resource, DESKTOP_SHELL_ERROR_INVALID_FILTER, "invalid window filter mode %u", mode);
+        return;
+    }
+
+    m_windowFilterMode = mode;
+    m_windowFilterWorkspaces = list;
+    updateWindowScopes();
+}
+
+bool DesktopShell::isInWindowFilter(Workspace *ws) const
+{
+    switch (m_windowFilterMode) {
+        case DESKTOP_SHELL_WINDOW_FILTER_CURRENT_WORKSPACE:
+            return ws && ws->isActive();
+        case DESKTOP_SHELL_WINDOW_FILTER_WORKSPACES:
+            return ws && std::find(m_windowFilterWorkspaces.begin(), m_windowFilterWorkspaces.end(), ws) != m_windowFilterWorkspaces.end();
+        default:
+            return true;
+    }
+}
+
+void DesktopShell::workspaceRemoved(Workspace *ws)
+{
+    auto i = std::find(m_windowFilterWorkspaces.begin(), m_windowFilterWorkspaces.end(), ws);
+    if (i != m_windowFilterWorkspaces.end()) {
+        m_windowFilterWorkspaces.erase(i);
+    }
+}
+
+void DesktopShell::batchWindows(wl_client *client, wl_resource *resource, wl_array *windows, uint32_t operation, int32_t workspace)
+{
+    std::vector<DesktopShellWindow *> list;
+    uint32_t *id;
+    wl_array_for_each(id, windows) {
+        if (DesktopShellWindow *w = DesktopShellWindow::fromId(*id)) {
+            list.push_back(w);
+        }
+    }
+
+    switch (operation) {
+        case DESKTOP_SHELL_WINDOW_OPERATION_MINIMIZE: {
+            // Deactivate only once at the end, instead of once per window
+            ShellSurface *active = nullptr;
+            for (DesktopShellWindow *w: list) {
+                if (w->shsurf()->isActive()) {
+                    active = w->shsurf();
+                }
+                w->setMinimized(true);
+            }
+            if (active) {
+                active->deactivate();
+            }
+        } break;
+        case DESKTOP_SHELL_WINDOW_OPERATION_RESTORE: {
+            ShellSurface *last = nullptr;
+            for (DesktopShellWindow *w: list) {
+                if (w->shsurf()->isMinimized()) {
+                    w->setMinimized(false);
+                    last = w->shsurf();
+                }
+            }
+            if (last) {
+                last->activate();
+            }
+        } break;
+        case DESKTOP_SHELL_WINDOW_OPERATION_MOVE_TO_WORKSPACE: {
+            Workspace *ws = workspace < 0 ? nullptr : Shell::workspace(workspace);
+            if (!ws) {
+                wl_resource_post_error(resource, DESKTOP_SHELL_ERROR_INVALID_WORKSPACE, "invalid workspace %d", workspace);
+                return;
+            }
+            for (DesktopShellWindow *w: list) {
+                ShellSurface *shsurf = w->shsurf();
+                if (shsurf->workspace() == ws || shsurf->isFullscreen()) {
+                    continue;
+                }
+                bool minimized = shsurf->isMinimized();
+                if (shsurf->workspace()) {
+                    shsurf->workspace()->removeSurface(shsurf);
+                }
+                ws->addSurface(shsurf);
+                if (minimized) {
+                    shsurf->hide();
+                }
+            }
+        } break;
+        case DESKTOP_SHELL_WINDOW_OPERATION_CLOSE:
+            for (DesktopShellWindow *w: list) {
+                w->shsurf()->close();
+            }
+            break;
+        default:
+            wl_resource_post_error(resource, DESKTOP_SHELL_ERROR_INVALID_OPERATION, "invalid window operation %u", operation);
+            break;
     }
 }
 
@@ -984,7 +1250,10 @@ const struct desktop_shell_interface DesktopShell::m_desktop_shell_implementatio
     wrapInterface(&DesktopShell::selectWorkspace),
     wrapInterface(&DesktopShell::quit),
     wrapInterface(&DesktopShell::addTrustedClient),
-    wrapInterface(&DesktopShell::pong)
+    wrapInterface(&DesktopShell::pong),
+    wrapInterface(&DesktopShell::getWindow),
+    wrapInterface(&DesktopShell::setWindowFilter),
+    wrapInterface(&DesktopShell::batchWindows)
 };
 
 void DesktopShell::setSplashSurface(wl_client *client, wl_resource *resource, wl_resource *output_resource, wl_resource *surface_resource)
@@ -1020,6 +1289,7 @@ module_init(struct weston_compositor *ec, int *argc, char *argv[])
 
     char *client = nullptr;
     char *sfile = nullptr;
+    bool standby = false;
 
     for (int i = *argc - 1; i >= 0; --i) {
         if (char *s = strstr(argv[i], "--nuclear-client=")) {
@@ -1028,6 +1298,9 @@ module_init(struct weston_compositor *ec, int *argc, char *argv[])
         } else if (char *s = strstr(argv[i], "--session-file=")) {
             sfile = strdup(s + 15);
             --*argc;
+        } else if (strcmp(argv[i], "--nuclear-standby") == 0) {
+            standby = true;
+            --*argc;
         }
     }
 
@@ -1038,6 +1311,7 @@ module_init(struct weston_compositor *ec, int *argc, char *argv[])
     if (sfile) {
         shell->m_sessionManager = new SessionManager(sfile);
     }
+    shell->setStandbyEnabled(standby);
     shell->init();
 
     return 0;
@@ -19,10 +19,12 @@
 #define DESKTOP_SHELL_H
 
 #include <list>
+#include <vector>
 #include <unordered_map>
 
 #include "shell.h"
 #include "utils.h"
+#include "latencyhistogram.h"
 
 class InputPanel;
 class WlShell;
@@ -40,19 +42,26 @@ public:
 
     bool isTrusted(wl_client *client, const char *interface) const override;
 
+    /* Whether the windows on the workspace pass the filter set by the shell client. */
+    bool isInWindowFilter(Workspace *ws) const;
+
 protected:
     virtual void init();
     virtual void setGrabCursor(Cursor cursor);
-    virtual void panelConfigure(weston_surface *es, int32_t sx, int32_t sy, Shell::PanelPosition pos) override;
     virtual ShellSurface *createShellSurface(weston_surface *surface, const weston_shell_client *client) override;
+    virtual void shellClientPromoted() override;
 
 private:
+    void activateShellClient();
     void sendInitEvents();
+    void sendWindowTable();
+    void updateWindowScopes();
     void workspaceAdded(DesktopShellWorkspace *ws);
     void surfaceResponsivenessChanged(ShellSurface *shsurf, bool responsive);
     void bind(struct wl_client *client, uint32_t version, uint32_t id);
     void bindSplash(wl_client *client, uint32_t version, uint32_t id);
     void unbind(struct wl_resource *resource);
+    void resetClientState();
     void moveBinding(struct weston_seat *seat, uint32_t time, uint32_t button);
     void resizeBinding(struct weston_seat *seat, uint32_t time, uint32_t button);
     void closeBinding(struct weston_seat *seat, uint32_t time, uint32_t button);
@@ -61,6 +70,11 @@ private:
     void trustedClientDestroyed(void *client);
     void pointerMotion(ShellSeat *seat, weston_pointer *pointer);
     void pingTimerTimeout();
+    void updatePingTimeout();
+    void reportPingLatency();
+    void windowsAreaChanged(weston_output *output);
+    void gameModeChanged(bool gameMode);
+    void workspaceRemoved(Workspace *ws);
 
     void setBackground(struct wl_client *client, struct wl_resource *resource, struct wl_resource *output_resource,
                                              struct wl_resource *surface_resource);
@@ -78,6 +92,9 @@ private:
     void quit(wl_client *client, wl_resource *resource);
     void addTrustedClient(wl_client *client, wl_resource *resource, int32_t fd, const char *interface);
     void pong(uint32_t serial);
+    void getWindow(wl_client *client, wl_resource *resource, uint32_t id, uint32_t window);
+    void setWindowFilter(wl_client *client, wl_resource *resource, uint32_t mode, wl_array *workspaces);
+    void batchWindows(wl_client *client, wl_resource *resource, wl_array *windows, uint32_t operation, int32_t workspace);
     void setSplashSurface(wl_client *client, wl_resource *resource, wl_resource *output_resource, wl_resource *surface_resource);
 
     static void configurePopup(weston_surface *es, int32_t sx, int32_t sy);
@@ -103,6 +120,12 @@ private:
     SessionManager *m_sessionManager;
     Timer m_pingTimer;
     uint32_t m_pingSerial;
+    uint32_t m_pingTime;
+    LatencyHistogram m_pingLatency;
+    Timer m_pingReportTimer;
+    uint32_t m_windowFilterMode;
+    // by identity, so that removing a workspace does not move the filter
+    std::vector<Workspace *> m_windowFilterWorkspaces;
 
     friend class DesktopShellSettings;
     friend int module_init(weston_compositor *ec, int *argc, char *argv[]);
@@ -15,22 +15,52 @@
  * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
+#include <algorithm>
+
 #include "desktopshellwindow.h"
-#include "shell.h"
+#include "desktop-shell.h"
 #include "shellsurface.h"
-
+#include "workspace.h"
+#include "windowtable.h"
+#include "imagescale.h"
+#include "executor.h"
 #include "wayland-desktop-shell-server-protocol.h"
 
+// Minimum time between two updates sent for the same window, in ms
+static const int MinUpdateInterval = 100;
+
+uint32_t DesktopShellWindow::s_nextId = 1;
+std::unordered_map<uint32_t, DesktopShellWindow *> DesktopShellWindow::s_windows;
+
 DesktopShellWindow::DesktopShellWindow()
                   : Interface()
+                  , m_id(s_nextId++)
                   , m_resource(nullptr)
+                  , m_inTable(false)
                   , m_state(DESKTOP_SHELL_WINDOW_STATE_INACTIVE)
+                  , m_dirty(0)
+                  , m_idleSource(nullptr)
+                  , m_rateLimit(MinUpdateInterval)
+                  , m_thumbnailWatched(false)
+                  , m_thumbnailChanged(false)
+                  , m_thumbnailTimer(16)
 {
+    s_windows[m_id] = this;
+    m_rateLimit.triggered.connect(this, &DesktopShellWindow::rateLimitExpired);
+    m_thumbnailTimer.triggered.connect(this, &DesktopShellWindow::thumbnailTimeout);
 }
 
 DesktopShellWindow::~DesktopShellWindow()
 {
     destroy();
+    s_windows.erase(m_id);
+}
+
+DesktopShellWindow *DesktopShellWindow::fromId(uint32_t id)
+{
+    auto it = s_windows.find(id);
+    return it == s_windows.end() ? nullptr : it->second;
 }
 
 void DesktopShellWindow::added()
@@ -40,6 +70,8 @@ void DesktopShellWindow::added()
     shsurf()->activeChangedSignal.connect(this, &DesktopShellWindow::activeChanged);
     shsurf()->mappedSignal.connect(this, &DesktopShellWindow::mapped);
     shsurf()->unmappedSignal.connect(this, &DesktopShellWindow::destroy);
+    shsurf()->workspaceChangedSignal.connect(this, &DesktopShellWindow::workspaceChanged);
+    shsurf()->committedSignal.connect(this, &DesktopShellWindow::committed);
 }
 
 ShellSurface *DesktopShellWindow::shsurf()
@@ -47,23 +79,50 @@ ShellSurface *DesktopShellWindow::shsurf()
     return static_cast<ShellSurface *>(object());
 }
 
+bool DesktopShellWindow::isWindow()
+{
+    return shsurf()->type() == ShellSurface::Type::TopLevel && !shsurf()->isTransient();
+}
+
+bool DesktopShellWindow::isInScope()
+{
+    return static_cast<DesktopShell *>(Shell::instance())->isInWindowFilter(shsurf()->workspace());
+}
+
+void DesktopShellWindow::updateScope()
+{
+    bool wanted = isWindow() && shsurf()->isMapped() && isInScope();
+    if (wanted && !m_resource && !m_inTable) {
+        create();
+    } else if (!wanted) {
+        destroy();
+    }
+}
+
+void DesktopShellWindow::workspaceChanged()
+{
+    updateScope();
+    // The window objects have no workspace event, only the table has it
+    if (m_inTable) {
+        markDirty(DirtyWorkspace);
+    }
+}
+
 void DesktopShellWindow::mapped()
 {
-    if (m_resource) {
+    if (m_resource || m_inTable) {
         return;
     }
 
-    ShellSurface::Type type = shsurf()->type();
-    if (type == ShellSurface::Type::TopLevel && !shsurf()->isTransient()) {
+    if (isWindow() && isInScope()) {
         create();
     }
 }
 
 void DesktopShellWindow::surfaceTypeChanged()
 {
-    ShellSurface::Type type = shsurf()->type();
-    if (type == ShellSurface::Type::TopLevel && !shsurf()->isTransient()) {
-        if (!m_resource) {
+    if (isWindow() && isInScope()) {
+        if (!m_resource && !m_inTable) {
             create();
         }
     } else {
@@ -83,32 +142,144 @@ void DesktopShellWindow::activeChanged()
 
 void DesktopShellWindow::create()
 {
-    m_resource = wl_resource_create(Shell::instance()->shellClient(), &desktop_shell_window_interface, 1, 0);
-    wl_resource_set_implementation(m_resource, &s_implementation, this, 0);
-    desktop_shell_send_window_added(Shell::instance()->shellClientResource(), m_resource, shsurf()->title().c_str(), m_state);
+    wl_resource *shell = Shell::instance()->shellClientResource();
+    if (!shell) {
+        return;
+    }
+
+    m_inTable = false;
+    m_dirty = 0;
+    setResource(wl_resource_create(Shell::instance()->shellClient(), &desktop_shell_window_interface, wl_resource_get_version(shell), 0));
+    desktop_shell_send_window_added(shell, m_resource, shsurf()->title().c_str(), m_state);
+    if (wl_resource_get_version(m_resource) >= 2) {
+        desktop_shell_window_send_id(m_resource, m_id);
+    }
+}
+
+void DesktopShellWindow::createFromTable(wl_client *client, uint32_t version, uint32_t id)
+{
+    m_inTable = false;
+    setResource(wl_resource_create(client, &desktop_shell_window_interface, version, id));
+}
+
+void DesktopShellWindow::setResource(wl_resource *resource)
+{
+    m_resource = resource;
+    wl_resource_set_implementation(m_resource, &s_implementation, this, [](wl_resource *res) {
+        static_cast<DesktopShellWindow *>(wl_resource_get_user_data(res))->m_resource = nullptr;
+    });
+}
+
+void DesktopShellWindow::addToTable(WindowTable *table)
+{
+    Workspace *ws = shsurf()->workspace();
+    table->addWindow(m_id, m_state, ws ? ws->number() : -1, shsurf()->title());
+    m_inTable = true;
+    m_dirty = 0;
 }
 
 void DesktopShellWindow::destroy()
 {
+    m_dirty = 0;
+    if (m_idleSource) {
+        wl_event_source_remove(m_idleSource);
+        m_idleSource = nullptr;
+    }
+    m_rateLimit.stop();
+    m_thumbnailWatched = false;
+    m_thumbnailChanged = false;
+    m_thumbnailTimer.stop();
+
     if (m_resource) {
         desktop_shell_window_send_removed(m_resource);
         wl_resource_destroy(m_resource);
-        m_resource = nullptr;
+    } else if (m_inTable) {
+        wl_resource *shell = Shell::instance()->shellClientResource();
+        if (shell) {
+            desktop_shell_send_window_removed(shell, m_id);
+        }
     }
+    m_inTable = false;
 }
 
 void DesktopShellWindow::sendState()
 {
-    if (m_resource) {
-        desktop_shell_window_send_state_changed(m_resource, m_state);
-    }
+    markDirty(DirtyState);
 }
 
 void DesktopShellWindow::sendTitle()
 {
+    markDirty(DirtyTitle);
+}
+
+void DesktopShellWindow::markDirty(int flags)
+{
+    if (!m_resource && !m_inTable) {
+        return;
+    }
+
+    m_dirty |= flags;
+    // When the rate limit is active the update will go out when it expires
+    if (m_idleSource || m_rateLimit.isRunning()) {
+        return;
+    }
+
+    wl_event_loop *loop = wl_display_get_event_loop(Shell::compositor()->wl_display);
+    m_idleSource = wl_event_loop_add_idle(loop, [](void *data) {
+        DesktopShellWindow *w = static_cast<DesktopShellWindow *>(data);
+        w->m_idleSource = nullptr;
+        w->flush();
+    }, this);
+}
+
+void DesktopShellWindow::flush()
+{
+    // The update goes out when the game mode ends, see flushAll()
+    if (!m_dirty || Shell::instance()->isInGameMode()) {
+        return;
+    }
+
     if (m_resource) {
-        desktop_shell_window_send_set_title(m_resource, shsurf()->title().c_str());
+        if (m_dirty & DirtyTitle) {
+            desktop_shell_window_send_set_title(m_resource, shsurf()->title().c_str());
+        }
+        if (m_dirty & DirtyState) {
+            desktop_shell_window_send_state_changed(m_resource, m_state);
+        }
+    } else if (m_inTable && Shell::instance()->shellClientResource()) {
+        Workspace *ws = shsurf()->workspace();
+        desktop_shell_send_window_updated(Shell::instance()->shellClientResource(), m_id, shsurf()->title().c_str(), m_state,
+                                          ws ? ws->number() : -1);
     }
+    m_dirty = 0;
+    m_rateLimit.start();
+}
+
+void DesktopShellWindow::flushAll()
+{
+    for (auto &i: s_windows) {
+        DesktopShellWindow *w = i.second;
+        if (!w->m_idleSource && !w->m_rateLimit.isRunning()) {
+            w->flush();
+        }
+    }
+}
+
+void DesktopShellWindow::resetTable()
+{
+    for (auto &i: s_windows) {
+        DesktopShellWindow *w = i.second;
+        if (w->m_inTable) {
+            w->m_inTable = false;
+            w->m_dirty = 0;
+        }
+    }
+}
+
+void DesktopShellWindow::rateLimitExpired()
+{
+    m_rateLimit.stop();
+    flush();
 }
 
 void DesktopShellWindow::setState(wl_client *client, wl_resource *resource, int32_t state)
@@ -132,12 +303,251 @@ void DesktopShellWindow::setState(wl_client *client, wl_resource *resource, int3
     sendState();
 }
 
+void DesktopShellWindow::setMinimized(bool minimized)
+{
+    if (minimized) {
+        m_state |= DESKTOP_SHELL_WINDOW_STATE_MINIMIZED;
+    } else {
+        m_state &= ~DESKTOP_SHELL_WINDOW_STATE_MINIMIZED;
+    }
+    shsurf()->setMinimized(minimized);
+    sendState();
+}
+
 void DesktopShellWindow::close(wl_client *client, wl_resource *resource)
 {
     shsurf()->close();
 }
 
+// The content of one surface of a window, at its position in the thumbnail
+struct SurfaceContent {
+    int x;
+    int y;
+    int width;
+    int height;
+    std::vector<uint8_t> pixels;
+};
+
+/*
+ * Copies the content of the surface and, if scale is not 0, of its
+ * sub-surfaces, bottom to top. Positions are in content pixels, scale being
+ * the number of content pixels per surface unit; sub-surfaces at another
+ * scale, e.g. because of a viewport, are left out.
+ * Returns false if the surface itself could not be copied.
+ */
+static bool copySurfaceTree(weston_surface *surface, int x, int y, int scale, std::vector<SurfaceContent> &contents)
+{
+    auto copy = [&]() {
+        int width, height;
+        weston_surface_get_content_size(surface, &width, &height);
+        if (width <= 0 || height <= 0 || (scale && (width != surface->width * scale || height != surface->height * scale))) {
+            return false;
+        }
+        contents.push_back(SurfaceContent());
+        SurfaceContent &content = contents.back();
+        content.x = x;
+        content.y = y;
+        content.width = width;
+        content.height = height;
+        content.pixels.resize(width * height * 4);
+        if (weston_surface_copy_content(surface, content.pixels.data(), content.pixels.size(), 0, 0, width, height) != 0) {
+            contents.pop_back();
+            return false;
+        }
+        return true;
+    };
+
+    // the list is empty until the first sub-surface is added, and then
+    // contains the surface itself too, top first
+    if (!scale || wl_list_empty(&surface->subsurface_list)) {
+        return copy();
+    }
+    bool copied = false;
+    weston_subsurface *sub;
+    wl_list_for_each_reverse(sub, &surface->subsurface_list, parent_link) {
+        if (sub->surface == surface) {
+            copied = copy();
+        } else {
+            copySurfaceTree(sub->surface, x + sub->position.x * scale, y + sub->position.y * scale, scale, contents);
+        }
+    }
+    return copied;
+}
+
+// Draws premultiplied RGBA contents over each other, clipped to the image
+static void compositeContents(const std::vector<SurfaceContent> &contents, uint8_t *dst, int width, int height)
+{
+    memset(dst, 0, width * height * 4);
+    for (const SurfaceContent &content: contents) {
+        int x1 = std::max(content.x, 0), x2 = std::min(content.x + content.width, width);
+        int y1 = std::max(content.y, 0), y2 = std::min(content.y + content.height, height);
+        for (int y = y1; y < y2; ++y) {
+            const uint8_t *s = content.pixels.data() + ((y - content.y) * content.width + x1 - content.x) * 4;
+            uint8_t *d = dst + (y * width + x1) * 4;
+            for (int x = x1; x < x2; ++x, s += 4, d += 4) {
+                int a = 255 - s[3];
+                if (a == 0) {
+                    memcpy(d, s, 4);
+                } else if (a < 255 || s[0] || s[1] || s[2]) {
+                    for (int i = 0; i < 4; ++i) {
+                        d[i] = std::min(s[i] + (d[i] * a + 127) / 255, 255);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/*
+ * The content of the window and of its sub-surfaces is copied on the
+ * compositor thread, composited and scaled on the executor and written to
+ * the client buffer back on the compositor thread, if both the buffer and
+ * the window resource are still there by then.
+ */
+struct DesktopShellWindow::ThumbnailCapture {
+    void bufferDestroyed(void *)
+    {
+        buffer = nullptr;
+        bufferDestroy.reset();
+    }
+    void resourceDestroyed(void *)
+    {
+        resource = nullptr;
+        resourceDestroy.reset();
+    }
+
+    wl_resource *buffer;
+    WlListener bufferDestroy;
+    wl_resource *resource;
+    WlListener resourceDestroy;
+    int srcWidth;
+    int srcHeight;
+    int dstWidth;
+    int dstHeight;
+    int dstStride;
+    // only touched by the worker until the done callback
+    std::vector<SurfaceContent> contents;
+    std::vector<uint8_t> result;
+    int width;
+    int height;
+};
+
+void DesktopShellWindow::captureThumbnail(wl_client *client, wl_resource *resource, wl_resource *buffer_resource)
+{
+    weston_surface *surface = shsurf()->weston_surface();
+    wl_shm_buffer *buffer = wl_shm_buffer_get(buffer_resource);
+    int contentWidth, contentHeight;
+    weston_surface_get_content_size(surface, &contentWidth, &contentHeight);
+    m_thumbnailWatched = true;
+
+    if (!buffer || contentWidth <= 0 || contentHeight <= 0 ||
+        (wl_shm_buffer_get_format(buffer) != WL_SHM_FORMAT_ARGB8888 &&
+         wl_shm_buffer_get_format(buffer) != WL_SHM_FORMAT_XRGB8888)) {
+        desktop_shell_window_send_thumbnail_done(resource, 0, 0);
+        return;
+    }
+
+    ThumbnailCapture *capture = new ThumbnailCapture;
+    capture->dstStride = wl_shm_buffer_get_stride(buffer);
+    // Never write past the end of a row, whatever width the buffer claims
+    capture->dstWidth = std::min(wl_shm_buffer_get_width(buffer), capture->dstStride / 4);
+    capture->dstHeight = wl_shm_buffer_get_height(buffer);
+
+    // The sub-surfaces are clipped to the surface, and they can only be
+    // placed if its content is an integer multiple of its size, else only
+    // the surface itself is copied
+    capture->srcWidth = contentWidth;
+    capture->srcHeight = contentHeight;
+    int scale = surface->width > 0 ? contentWidth / surface->width : 0;
+    if (scale && (contentWidth != surface->width * scale || contentHeight != surface->height * scale)) {
+        scale = 0;
+    }
+
+    // weston gives us RGBA bytes, wl_shm wants BGRA ones
+    if (capture->dstWidth <= 0 || capture->dstHeight <= 0 || !copySurfaceTree(surface, 0, 0, scale, capture->contents)) {
+        delete capture;
+        desktop_shell_window_send_thumbnail_done(resource, 0, 0);
+        return;
+    }
+
+    capture->buffer = buffer_resource;
+    capture->bufferDestroy.listen(wl_resource_get_destroy_signal(buffer_resource));
+    capture->bufferDestroy.signal->connect(capture, &ThumbnailCapture::bufferDestroyed);
+    capture->resource = resource;
+    capture->resourceDestroy.listen(wl_resource_get_destroy_signal(resource));
+    capture->resourceDestroy.signal->connect(capture, &ThumbnailCapture::resourceDestroyed);
+
+    Shell::executor()->run([capture]() {
+        std::vector<uint8_t> pixels;
+        const SurfaceContent &first = capture->contents.front();
+        if (capture->contents.size() == 1 && first.x == 0 && first.y == 0 &&
+            first.width == capture->srcWidth && first.height == capture->srcHeight) {
+            pixels.swap(capture->contents.front().pixels);
+        } else {
+            pixels.resize(capture->srcWidth * capture->srcHeight * 4);
+            compositeContents(capture->contents, pixels.data(), capture->srcWidth, capture->srcHeight);
+        }
+        std::vector<SurfaceContent>().swap(capture->contents);
+
+        capture->result.resize(capture->dstStride * capture->dstHeight);
+        downscaleImage(pixels.data(), capture->srcWidth, capture->srcHeight, capture->srcWidth * 4,
+                       capture->result.data(), capture->dstWidth, capture->dstHeight, capture->dstStride,
+                       true, &capture->width, &capture->height);
+    }, [capture]() {
+        // The window destroys its resource when it goes away
+        if (capture->resource) {
+            DesktopShellWindow *window = static_cast<DesktopShellWindow *>(wl_resource_get_user_data(capture->resource));
+            window->thumbnailCaptured(capture);
+        }
+        delete capture;
+    });
+}
+
+void DesktopShellWindow::thumbnailCaptured(ThumbnailCapture *capture)
+{
+    if (!capture->buffer) {
+        desktop_shell_window_send_thumbnail_done(capture->resource, 0, 0);
+        return;
+    }
+
+    wl_shm_buffer *buffer = wl_shm_buffer_get(capture->buffer);
+    wl_shm_buffer_begin_access(buffer);
+    memcpy(wl_shm_buffer_get_data(buffer), capture->result.data(), capture->result.size());
+    wl_shm_buffer_end_access(buffer);
+    desktop_shell_window_send_thumbnail_done(capture->resource, capture->width, capture->height);
+}
+
+void DesktopShellWindow::committed()
+{
+    if (!m_thumbnailWatched || !m_resource) {
+        return;
+    }
+
+    if (m_thumbnailTimer.isRunning()) {
+        m_thumbnailChanged = true;
+        return;
+    }
+
+    desktop_shell_window_send_thumbnail_changed(m_resource);
+    weston_output *output = shsurf()->output();
+    if (output && output->current_mode && output->current_mode->refresh > 0) {
+        // refresh is in mHz
+        m_thumbnailTimer.setInterval(std::max(1000000 / output->current_mode->refresh, 1));
+    }
+    m_thumbnailTimer.start();
+}
+
+void DesktopShellWindow::thumbnailTimeout()
+{
+    m_thumbnailTimer.stop();
+    if (m_thumbnailChanged) {
+        m_thumbnailChanged = false;
+        committed();
+    }
+}
+
 const struct desktop_shell_window_interface DesktopShellWindow::s_implementation = {
     wrapInterface(&DesktopShellWindow::setState),
-    wrapInterface(&DesktopShellWindow::close)
+    wrapInterface(&DesktopShellWindow::close),
+    wrapInterface(&DesktopShellWindow::captureThumbnail)
 };
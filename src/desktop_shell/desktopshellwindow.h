@@ -18,11 +18,16 @@
 #ifndef DESKTOPSHELLWINDOW_H
 #define DESKTOPSHELLWINDOW_H
 
+#include <unordered_map>
+#include <vector>
+
 #include <wayland-server.h>
 
 #include "interface.h"
+#include "utils.h"
 
 class ShellSurface;
+class WindowTable;
 
 class DesktopShellWindow : public Interface
 {
@@ -30,25 +35,69 @@ public:
     DesktopShellWindow();
     ~DesktopShellWindow();
 
+    ShellSurface *shsurf();
+    void setMinimized(bool minimized);
     void create();
+    void createFromTable(wl_client *client, uint32_t version, uint32_t id);
+    void addToTable(WindowTable *table);
+
+    bool isInScope();
+    void updateScope();
+
+    inline uint32_t id() const { return m_id; }
+    inline bool isInTable() const { return m_inTable; }
+    static DesktopShellWindow *fromId(uint32_t id);
+    /* Send the updates held back during the game mode. */
+    static void flushAll();
+    /* Forget what the shell client knew from the window table, when it goes away. */
+    static void resetTable();
 
 protected:
     virtual void added() override;
 
 private:
-    ShellSurface *shsurf();
+    bool isWindow();
     void surfaceTypeChanged();
     void activeChanged();
     void mapped();
+    void workspaceChanged();
     void destroy();
+    void setResource(wl_resource *resource);
     void sendState();
     void sendTitle();
+    void markDirty(int flags);
+    void flush();
+    void rateLimitExpired();
     void setState(wl_client *client, wl_resource *resource, int32_t state);
     void close(wl_client *client, wl_resource *resource);
+    void captureThumbnail(wl_client *client, wl_resource *resource, wl_resource *buffer_resource);
+    struct ThumbnailCapture;
+    void thumbnailCaptured(ThumbnailCapture *capture);
+    void committed();
+    void thumbnailTimeout();
 
+    uint32_t m_id;
     wl_resource *m_resource;
+    // true if the shell client knows this window only from the window table
+    bool m_inTable;
     int32_t m_state;
 
+    enum Dirty {
+        DirtyTitle = 1,
+        DirtyState = 2,
+        DirtyWorkspace = 4
+    };
+    int m_dirty;
+    wl_event_source *m_idleSource;
+    Timer m_rateLimit;
+
+    // the client wants thumbnail_changed, rate limited to the output frame rate
+    bool m_thumbnailWatched;
+    bool m_thumbnailChanged;
+    Timer m_thumbnailTimer;
+
+    static uint32_t s_nextId;
+    static std::unordered_map<uint32_t, DesktopShellWindow *> s_windows;
     static const struct desktop_shell_window_interface s_implementation;
 };
 
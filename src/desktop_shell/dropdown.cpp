@@ -146,4 +146,5 @@ void Dropdown::bind(wl_client *client, uint32_t version, uint32_t id)
 {
     new Instance(this, wl_resource_create(client, &nuclear_dropdown_interface, version, id));
     m_instances.push_back(client);
+    boundSignal(client);
 }
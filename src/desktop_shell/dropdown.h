@@ -23,6 +23,7 @@
 #include <wayland-server.h>
 
 #include "interface.h"
+#include "utils.h"
 
 class Instance;
 
@@ -33,6 +34,8 @@ public:
 
     std::list<wl_client *> boundClients() const;
 
+    Signal<wl_client *> boundSignal;
+
 private:
     void bind(wl_client *client, uint32_t version, uint32_t id);
 
@@ -0,0 +1,129 @@
+/*
+ * Copyright 2014  Giulio Camuffo <giuliocamuffo@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+#include <string>
+
+#include "windowtable.h"
+
+static const uint32_t Magic = 0x3154574e; // "NWT1"
+static const uint32_t Version = 1;
+static const uint32_t HeaderFields = 8;
+static const uint32_t EntryFields = 5;
+
+static int createAnonymousFile()
+{
+    int fd = -1;
+#ifdef MFD_CLOEXEC
+    fd = memfd_create("nuclear-window-table", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd >= 0) {
+        return fd;
+    }
+#endif
+
+    const char *dir = getenv("XDG_RUNTIME_DIR");
+    if (!dir) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    std::string path = std::string(dir) + "/nuclear-window-table-XXXXXX";
+    fd = mkostemp(&path[0], O_CLOEXEC);
+    if (fd >= 0) {
+        unlink(path.c_str());
+    }
+    return fd;
+}
+
+WindowTable::WindowTable(uint32_t serial)
+           : m_serial(serial)
+{
+}
+
+void WindowTable::addWindow(uint32_t id, int32_t state, int32_t workspace, const std::string &title)
+{
+    m_entries.push_back({ id, state, workspace, title });
+}
+
+int WindowTable::createFile(size_t *size) const
+{
+    size_t entriesOffset = HeaderFields * sizeof(uint32_t);
+    size_t stringsOffset = entriesOffset + m_entries.size() * EntryFields * sizeof(uint32_t);
+    size_t total = stringsOffset;
+    for (const Entry &e: m_entries) {
+        total += e.title.size() + 1;
+    }
+
+    int fd = createAnonymousFile();
+    if (fd < 0) {
+        fprintf(stderr, "Failed to create the window table file: %s\n", strerror(errno));
+        return -1;
+    }
+
+    if (ftruncate(fd, total) < 0) {
+        fprintf(stderr, "Failed to resize the window table file: %s\n", strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    void *data = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Failed to map the window table file: %s\n", strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    uint32_t *header = static_cast<uint32_t *>(data);
+    header[0] = Magic;
+    header[1] = Version;
+    header[2] = m_serial;
+    header[3] = m_entries.size();
+    header[4] = EntryFields * sizeof(uint32_t);
+    header[5] = entriesOffset;
+    header[6] = 0;
+    header[7] = 0;
+
+    uint32_t *entry = header + HeaderFields;
+    char *strings = static_cast<char *>(data) + stringsOffset;
+    for (const Entry &e: m_entries) {
+        entry[0] = e.id;
+        entry[1] = e.state;
+        entry[2] = e.workspace;
+        entry[3] = strings - static_cast<char *>(data);
+        entry[4] = e.title.size();
+        entry += EntryFields;
+
+        memcpy(strings, e.title.c_str(), e.title.size() + 1);
+        strings += e.title.size() + 1;
+    }
+
+    munmap(data, total);
+
+#ifdef F_ADD_SEALS
+    fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+#endif
+
+    *size = total;
+    return fd;
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright 2014  Giulio Camuffo <giuliocamuffo@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WINDOWTABLE_H
+#define WINDOWTABLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+/*
+ * Serializes the windows existing at a given time in a read-only file,
+ * to be sent to the shell client in one go with the window_table event.
+ * See the window_table event in desktop-shell.xml for the layout.
+ */
+class WindowTable
+{
+public:
+    WindowTable(uint32_t serial);
+
+    void addWindow(uint32_t id, int32_t state, int32_t workspace, const std::string &title);
+
+    /*
+     * Write the table in a new anonymous file. Returns its fd, or -1 on
+     * failure. The caller owns the fd.
+     */
+    int createFile(size_t *size) const;
+
+private:
+    struct Entry {
+        uint32_t id;
+        int32_t state;
+        int32_t workspace;
+        std::string title;
+    };
+
+    uint32_t m_serial;
+    std::vector<Entry> m_entries;
+};
+
+#endif
@@ -60,7 +60,8 @@ struct DGrab : public ShellGrab {
                 weston_matrix_init(matrix);
                 weston_matrix_scale(matrix, scale, scale, 1.f);
 
-                surface->setPosition(surface->transformedX(), surface->transformedY());
+                IRect2D geom = surface->transformedRect();
+                surface->setPosition(geom.x, geom.y);
                 surface->addTransform(&surfTransform);
                 surface->moveStartSignal(surface);
                 setCursor(Cursor::Move);
@@ -84,8 +85,9 @@ struct DGrab : public ShellGrab {
         if (state == WL_POINTER_BUTTON_STATE_PRESSED) {
             ShellSurface *shsurf = pointer()->focus ? Shell::getShellSurface(pointer()->focus->surface) : nullptr;
             if (shsurf) {
-                dx = wl_fixed_from_double(shsurf->transformedX()) - pointer()->grab_x;
-                dy = wl_fixed_from_double(shsurf->transformedY()) - pointer()->grab_y;
+                IRect2D geom = shsurf->transformedRect();
+                dx = wl_fixed_from_double(geom.x) - pointer()->grab_x;
+                dy = wl_fixed_from_double(geom.y) - pointer()->grab_y;
                 surface = shsurf;
                 moving = false;
                 wl_list_init(&surfTransform.link);
@@ -172,9 +174,10 @@ void GridDesktops::run(struct weston_seat *ws)
 
     if (m_scaled) {
         shell->showPanels();
-        shell->resetWorkspaces();
+        // Select the workspace while resetting them, as a normal workspace
+        // switch here would trigger the transitions meant for that
+        shell->resetWorkspaces(m_setWs);
         m_grab->end();
-        shell->selectWorkspace(m_setWs);
         for (int i = 0; i < numWs; ++i) {
             Workspace *w = shell->workspace(i);
 
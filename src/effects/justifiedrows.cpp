@@ -0,0 +1,76 @@
+/*
+ * Copyright 2014  Giulio Camuffo <giuliocamuffo@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "justifiedrows.h"
+
+std::vector<IRect2D> justifiedRows(const IRect2D &area, const std::vector<IVector2D> &sizes)
+{
+    const int spacing = 20;
+    const int n = sizes.size();
+    std::vector<IRect2D> cells(n, IRect2D(0, 0, 0, 0));
+
+    // Fill the rows for a row height, returning the height they take
+    auto fill = [&](float rowHeight, bool place) -> float {
+        float y = 0;
+        int first = 0;
+        float aspects = 0;
+        for (int i = 0; i < n; ++i) {
+            aspects += (float)sizes[i].x / (float)sizes[i].y;
+            float gaps = spacing * (i - first);
+            bool last = i == n - 1;
+            if (aspects * rowHeight + gaps < area.width && !last) {
+                continue;
+            }
+
+            // Stretch the row to the width, but not the last one if it is short
+            float height = (area.width - gaps) / aspects;
+            if (height > rowHeight) {
+                height = rowHeight;
+            }
+            if (place) {
+                float x = (area.width - aspects * height - gaps) / 2.f;
+                for (int j = first; j <= i; ++j) {
+                    float w = height * sizes[j].x / sizes[j].y;
+                    cells[j] = IRect2D(x, y, w, height);
+                    x += w + spacing;
+                }
+            }
+            y += height + spacing;
+            first = i + 1;
+            aspects = 0;
+        }
+        return y - spacing;
+    };
+
+    float lo = 1, hi = area.height;
+    for (int i = 0; i < 16; ++i) {
+        float mid = (lo + hi) / 2.f;
+        if (fill(mid, false) <= area.height) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    int offset = (area.height - fill(lo, true)) / 2;
+    for (IRect2D &cell: cells) {
+        cell.x += area.x;
+        cell.y += area.y + offset;
+    }
+    return cells;
+}
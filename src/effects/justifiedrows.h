@@ -0,0 +1,35 @@
+/*
+ * Copyright 2014  Giulio Camuffo <giuliocamuffo@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef JUSTIFIEDROWS_H
+#define JUSTIFIEDROWS_H
+
+#include <vector>
+
+#include "geometry2d.h"
+
+/*
+ * Justified rows, like a photo gallery: the windows keep their aspect ratio
+ * and are packed in rows filling the width of the area, so that windows of
+ * different shapes don't waste the space a grid of equal cells would. The
+ * row height is found by bisection, each step being a single pass over the
+ * windows, so this stays fast with hundreds of them.
+ */
+std::vector<IRect2D> justifiedRows(const IRect2D &area, const std::vector<IVector2D> &sizes);
+
+#endif
@@ -18,12 +18,14 @@
 #include "minimizeeffect.h"
 #include "animation.h"
 #include "shellsurface.h"
+#include "shell.h"
 
 static const int ANIM_DURATION = 150;
 
 struct MinimizeEffect::Surface {
+    MinimizeEffect *effect;
     ShellSurface *surface;
-    Animation animation;
+    Group *group;
     weston_transform transform;
     float targetY;
     bool minimizing;
@@ -39,10 +41,7 @@ struct MinimizeEffect::Surface {
         targetY = surf->transformedHeight() / 2.f;
         surf->addTransform(&transform);
 
-        animation.setStart(1);
-        animation.setTarget(0.01);
-        animation.run(surf->output(), ANIM_DURATION, Animation::Flags::SendDone);
-
+        effect->enqueue(this);
     }
     void unminimized(ShellSurface *surf)
     {
@@ -54,9 +53,7 @@ struct MinimizeEffect::Surface {
 
         surf->addTransform(&transform);
 
-        animation.setStart(0.01);
-        animation.setTarget(1);
-        animation.run(surf->output(), ANIM_DURATION, Animation::Flags::SendDone);
+        effect->enqueue(this);
     }
     void animate(float value)
     {
@@ -77,16 +74,50 @@ struct MinimizeEffect::Surface {
     }
 };
 
+// The surfaces (un)minimized in the same dispatch on the same output share
+// a single animation
+struct MinimizeEffect::Group {
+    MinimizeEffect *effect;
+    weston_output *output;
+    bool minimizing;
+    Animation animation;
+    std::list<Surface *> surfaces;
+
+    void animate(float value)
+    {
+        for (Surface *s: surfaces) {
+            s->animate(value);
+        }
+    }
+    void done()
+    {
+        for (Surface *s: surfaces) {
+            s->group = nullptr;
+            s->done();
+        }
+        effect->m_groups.remove(this);
+        delete this;
+    }
+};
+
 MinimizeEffect::MinimizeEffect()
               : Effect()
+              , m_idleSource(nullptr)
 {
 }
 
 MinimizeEffect::~MinimizeEffect()
 {
+    if (m_idleSource) {
+        wl_event_source_remove(m_idleSource);
+    }
+    for (Group *g: m_groups) {
+        delete g;
+    }
     while (!m_surfaces.empty()) {
         Surface *s = m_surfaces.front();
         s->surface->minimizedSignal.disconnect(s);
+        s->surface->unminimizedSignal.disconnect(s);
         delete s;
         m_surfaces.pop_front();
     }
@@ -95,14 +126,14 @@ MinimizeEffect::~MinimizeEffect()
 void MinimizeEffect::addedSurface(ShellSurface *surface)
 {
     Surface *surf = new Surface;
+    surf->effect = this;
     surf->surface = surface;
+    surf->group = nullptr;
     wl_list_init(&surf->transform.link);
 
     surface->minimizedSignal.connect(surf, &Surface::minimized);
     surface->unminimizedSignal.connect(surf, &Surface::unminimized);
 
-    surf->animation.updateSignal->connect(surf, &Surface::animate);
-    surf->animation.doneSignal->connect(surf, &Surface::done);
     m_surfaces.push_back(surf);
 }
 
@@ -112,6 +143,8 @@ void MinimizeEffect::removedSurface(ShellSurface *surface)
         Surface *s = *i;
         if (s->surface == surface) {
             surface->minimizedSignal.disconnect(s);
+            surface->unminimizedSignal.disconnect(s);
+            dequeue(s);
             delete *i;
             m_surfaces.erase(i);
             break;
@@ -119,6 +152,72 @@ void MinimizeEffect::removedSurface(ShellSurface *surface)
     }
 }
 
+void MinimizeEffect::dequeue(Surface *surface)
+{
+    m_pending.remove(surface);
+
+    Group *g = surface->group;
+    if (g) {
+        surface->group = nullptr;
+        g->surfaces.remove(surface);
+        if (g->surfaces.empty()) {
+            m_groups.remove(g);
+            delete g;
+        }
+    }
+}
+
+void MinimizeEffect::enqueue(Surface *surface)
+{
+    dequeue(surface);
+    m_pending.push_back(surface);
+
+    if (!m_idleSource) {
+        wl_event_loop *loop = wl_display_get_event_loop(Shell::compositor()->wl_display);
+        m_idleSource = wl_event_loop_add_idle(loop, [](void *data) {
+            MinimizeEffect *e = static_cast<MinimizeEffect *>(data);
+            e->m_idleSource = nullptr;
+            e->runPending();
+        }, this);
+    }
+}
+
+void MinimizeEffect::runPending()
+{
+    // The animations follow the frames of their output, so group by output too
+    std::list<Group *> groups;
+    for (Surface *s: m_pending) {
+        weston_output *output = s->surface->output();
+        Group *g = nullptr;
+        for (Group *c: groups) {
+            if (c->minimizing == s->minimizing && c->output == output) {
+                g = c;
+                break;
+            }
+        }
+
+        if (!g) {
+            g = new Group;
+            g->effect = this;
+            g->output = output;
+            g->minimizing = s->minimizing;
+            g->animation.updateSignal->connect(g, &Group::animate);
+            g->animation.doneSignal->connect(g, &Group::done);
+            groups.push_back(g);
+            m_groups.push_back(g);
+        }
+        s->group = g;
+        g->surfaces.push_back(s);
+    }
+    m_pending.clear();
+
+    for (Group *g: groups) {
+        g->animation.setStart(g->minimizing ? 1 : 0.01);
+        g->animation.setTarget(g->minimizing ? 0.01 : 1);
+        g->animation.run(g->output, ANIM_DURATION, Animation::Flags::SendDone);
+    }
+}
+
 
 
 MinimizeEffect::Settings::Settings()
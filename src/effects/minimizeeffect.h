@@ -47,7 +47,15 @@ protected:
 
 private:
     struct Surface;
+    struct Group;
+    void enqueue(Surface *surface);
+    void dequeue(Surface *surface);
+    void runPending();
+
     std::list<Surface *> m_surfaces;
+    std::list<Surface *> m_pending;
+    std::list<Group *> m_groups;
+    wl_event_source *m_idleSource;
 };
 
 #endif
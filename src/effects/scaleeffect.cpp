@@ -16,6 +16,9 @@
  */
 
 #include <linux/input.h>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
 
 #include "scaleeffect.h"
 #include "shellsurface.h"
@@ -24,6 +27,7 @@
 #include "animationcurve.h"
 #include "shellseat.h"
 #include "binding.h"
+#include "justifiedrows.h"
 
 const float INACTIVE_ALPHA = 0.8;
 const int ALPHA_ANIM_DURATION = 200;
@@ -47,8 +51,6 @@ struct SurfaceTransform {
 struct Grab : public ShellGrab {
     void focus() override
     {
-        Workspace *currWs = Shell::instance()->currentWorkspace();
-
         wl_fixed_t sx, sy;
         weston_view *view = weston_compositor_pick_view(pointer()->seat->compositor, pointer()->x, pointer()->y, &sx, &sy);
 
@@ -57,22 +59,7 @@ struct Grab : public ShellGrab {
         }
 
         surface = view;
-
-        for (SurfaceTransform *tr: effect->m_surfaces) {
-            if (tr->surface->workspace() != currWs) {
-                continue;
-            }
-
-            float alpha = (tr->surface->is(view) ? 1.0 : INACTIVE_ALPHA);
-            float curr = tr->surface->alpha();
-            if (alpha == curr) {
-                continue;
-            }
-
-            tr->alphaAnim.setStart(curr);
-            tr->alphaAnim.setTarget(alpha);
-            tr->alphaAnim.run(tr->surface->output(), ALPHA_ANIM_DURATION);
-        }
+        effect->setHovered(view ? effect->findTransform(Shell::getShellSurface(view->surface)) : nullptr);
     }
     void button(uint32_t time, uint32_t button, uint32_t state) override
     {
@@ -88,10 +75,13 @@ struct Grab : public ShellGrab {
     weston_view *surface;
 };
 
+const int ANIM_DURATION = 500;
+
 ScaleEffect::ScaleEffect()
            : Effect()
            , m_scaled(false)
            , m_grab(new Grab)
+           , m_hovered(nullptr)
 {
     m_grab->effect = this;
     Binding *b = new Binding();
@@ -115,127 +105,181 @@ void ScaleEffect::run(weston_seat *seat, uint32_t time, Binding::HotSpot hs)
     run(seat);
 }
 
+bool ScaleEffect::isInLayout(SurfaceTransform *surf) const
+{
+    return surf->surface->isMapped() && surf->surface->workspace() == Shell::instance()->currentWorkspace();
+}
+
 void ScaleEffect::run(struct weston_seat *ws)
 {
-    int num = m_surfaces.size();
-    if ((num == 0 && !m_scaled) || Shell::instance()->isInFullscreen()) {
+    if (m_scaled) {
+        for (SurfaceTransform *surf: m_surfaces) {
+            if (!isInLayout(surf)) {
+                continue;
+            }
+
+            surf->minimize = surf->wasMinimized && surf->surface != m_chosenSurface;
+            moveTo(surf, 1.f, 0, 0, Animation::Flags::SendDone);
+            fadeTo(surf, surf->minimize ? 0.f : 1.f);
+        }
+        m_scaled = false;
+        m_seat = nullptr;
+        m_hovered = nullptr;
+        m_grab->end();
+        Shell::instance()->showPanels();
+        return;
+    }
+
+    if (Shell::instance()->isInFullscreen()) {
         return;
     }
 
-    num = 0;
-    Workspace *currWs = Shell::instance()->currentWorkspace();
+    int num = 0;
     for (SurfaceTransform *surf: m_surfaces) {
-        if (surf->surface->workspace() == currWs) {
+        if (isInLayout(surf)) {
             ++num;
         }
     }
-
     if (num == 0) {
         return;
     }
 
-    const int ANIM_DURATION = 500;
+    for (SurfaceTransform *surf: m_surfaces) {
+        if (isInLayout(surf)) {
+            enter(surf);
+        }
+    }
+    m_scaled = true;
+    layout();
+
+    m_seat = ws;
+    m_chosenSurface = nullptr;
+    m_hovered = nullptr;
+    m_grab->surface = nullptr;
+    m_grab->start(ws, Cursor::Arrow);
+    Shell::instance()->hidePanels();
+    if (ws->pointer_state->focus) {
+        setHovered(findTransform(Shell::getShellSurface(ws->pointer_state->focus->surface)));
+    }
+}
 
-    int numCols = ceil(sqrt(num));
-    int numRows = ceil((float)num / (float)numCols);
+void ScaleEffect::enter(SurfaceTransform *surf)
+{
+    surf->wasMinimized = surf->surface->isMinimized();
+    if (surf->wasMinimized) {
+        surf->surface->show();
+    }
+
+    struct weston_matrix *matrix = &surf->transform.matrix;
+    weston_matrix_init(matrix);
+    weston_matrix_scale(matrix, surf->cs, surf->cs, 1.f);
+    weston_matrix_translate(matrix, surf->cx, surf->cy, 0);
+    surf->surface->addTransform(&surf->transform);
+
+    surf->alphaAnim.setStart(surf->wasMinimized ? 0 : surf->surface->alpha());
+    surf->alphaAnim.setTarget(INACTIVE_ALPHA);
+    surf->alphaAnim.run(surf->surface->output(), ALPHA_ANIM_DURATION);
+}
 
-    int r = 0, c = 0;
+/*
+ * Compute the cell of every window and move only the ones whose cell changed,
+ * starting from where they are now, so that adding or removing a window while
+ * scaled doesn't restart the animations of the others. Each output is laid
+ * out on its own.
+ */
+void ScaleEffect::layout()
+{
+    std::unordered_map<weston_output *, std::vector<SurfaceTransform *>> outputs;
     for (SurfaceTransform *surf: m_surfaces) {
-        if (!surf->surface->isMapped() || surf->surface->workspace() != currWs) {
-            continue;
+        if (isInLayout(surf)) {
+            outputs[surf->surface->output()].push_back(surf);
         }
+    }
 
-        if (m_scaled) {
-            surf->minimize = surf->wasMinimized && surf->surface != m_chosenSurface;
-
-            surf->ss = surf->cs;
-            surf->ts = 1.f;
+    for (auto &i: outputs) {
+        weston_output *out = i.first;
+        const std::vector<SurfaceTransform *> &surfaces = i.second;
 
-            surf->sx = surf->cx;
-            surf->sy = surf->cy;
-            surf->tx = surf->ty = 0.f;
+        const int margin_w = out->width / 70;
+        const int margin_h = out->height / 70;
+        IRect2D area(out->x + margin_w, out->y + margin_h, out->width - 2 * margin_w, out->height - 2 * margin_h);
 
-            surf->animation.setStart(0.f);
-            surf->animation.setTarget(1.f);
-            surf->animation.run(surf->surface->output(), ANIM_DURATION, Animation::Flags::SendDone);
+        std::vector<IVector2D> sizes;
+        sizes.reserve(surfaces.size());
+        for (SurfaceTransform *surf: surfaces) {
+            sizes.push_back(IVector2D(std::max(surf->surface->width(), 1), std::max(surf->surface->height(), 1)));
+        }
 
-            surf->alphaAnim.setStart(surf->surface->alpha());
-            surf->alphaAnim.setTarget(surf->minimize ? 0.f : 1.f);
-            surf->alphaAnim.run(surf->surface->output(), ALPHA_ANIM_DURATION);
-        } else {
-            surf->wasMinimized = surf->surface->isMinimized();
-            if (surf->wasMinimized) {
-                surf->surface->show();
-            }
+        std::vector<IRect2D> cells = justifiedRows(area, sizes);
+        for (size_t j = 0; j < surfaces.size(); ++j) {
+            SurfaceTransform *surf = surfaces[j];
+            const IRect2D &cell = cells[j];
 
-            int cellW = surf->surface->output()->width / numCols;
-            int cellH = surf->surface->output()->height / numRows;
+            // Never make a window bigger than it is
+            float scale = std::min((float)cell.height / (float)sizes[j].y, 1.f);
+            int x = cell.x - surf->surface->x() + (cell.width - sizes[j].x * scale) / 2.f;
+            int y = cell.y - surf->surface->y() + (cell.height - sizes[j].y * scale) / 2.f;
 
-            float rx = (float)cellW / (float)surf->surface->transformedWidth();
-            float ry = (float)cellH / (float)surf->surface->transformedHeight();
-            if (rx > ry) {
-                rx = ry;
-            } else {
-                ry = rx;
+            if (scale != surf->ts || x != surf->tx || y != surf->ty) {
+                moveTo(surf, scale, x, y);
             }
-            int x = c * cellW - surf->surface->x() + (cellW - (surf->surface->transformedWidth() * rx)) / 2.f;
-            int y = r * cellH - surf->surface->y() + (cellH - (surf->surface->transformedHeight() * ry)) / 2.f;
+        }
+    }
+}
 
-            struct weston_matrix *matrix = &surf->transform.matrix;
-            weston_matrix_init(matrix);
-            weston_matrix_scale(matrix, surf->cs, surf->cs, 1.f);
-            weston_matrix_translate(matrix, surf->cx, surf->cy, 0);
+void ScaleEffect::moveTo(SurfaceTransform *surf, float scale, int x, int y, Animation::Flags flags)
+{
+    surf->ss = surf->cs;
+    surf->sx = surf->cx;
+    surf->sy = surf->cy;
 
-            surf->ss = surf->cs;
-            surf->sx = surf->cx;
-            surf->sy = surf->cy;
+    surf->ts = scale;
+    surf->tx = x;
+    surf->ty = y;
 
-            surf->ts = rx * surf->cs;
-            surf->tx = x;
-            surf->ty = y;
+    surf->animation.setStart(0.f);
+    surf->animation.setTarget(1.f);
+    surf->animation.run(surf->surface->output(), ANIM_DURATION, flags);
+}
 
-            surf->animation.setStart(0.f);
-            surf->animation.setTarget(1.f);
-            surf->animation.run(surf->surface->output(), ANIM_DURATION);
+void ScaleEffect::fadeTo(SurfaceTransform *surf, float alpha)
+{
+    float curr = surf->surface->alpha();
+    if (alpha == curr) {
+        return;
+    }
 
-            surf->alphaAnim.setStart(surf->wasMinimized ? 0 : surf->surface->alpha());
-            surf->alphaAnim.setTarget(INACTIVE_ALPHA);
-            surf->alphaAnim.run(surf->surface->output(), ALPHA_ANIM_DURATION);
+    surf->alphaAnim.setStart(curr);
+    surf->alphaAnim.setTarget(alpha);
+    surf->alphaAnim.run(surf->surface->output(), ALPHA_ANIM_DURATION);
+}
 
-            surf->surface->addTransform(&surf->transform);
-        }
-        if (++c >= numCols) {
-            c = 0;
-            ++r;
-        }
+void ScaleEffect::setHovered(SurfaceTransform *surf)
+{
+    if (surf && !isInLayout(surf)) {
+        surf = nullptr;
+    }
+    if (surf == m_hovered) {
+        return;
     }
-    m_scaled = !m_scaled;
-    if (m_scaled) {
-        m_seat = ws;
-        m_chosenSurface = nullptr;
-        m_grab->surface = nullptr;
-        m_grab->start(ws, Cursor::Arrow);
-        Shell::instance()->hidePanels();
-        if (ws->pointer_state->focus) {
-            ShellSurface *s = Shell::getShellSurface(ws->pointer_state->focus->surface);
-            if (!s) {
-                return;
-            }
 
-            for (SurfaceTransform *tr: m_surfaces) {
-                if (tr->surface == s) {
-                    tr->alphaAnim.setStart(tr->surface->alpha());
-                    tr->alphaAnim.setTarget(1.0);
-                    tr->alphaAnim.run(tr->surface->output(), ALPHA_ANIM_DURATION);
-                    break;
-                }
-            }
+    if (m_hovered) {
+        fadeTo(m_hovered, INACTIVE_ALPHA);
+    }
+    if (surf) {
+        fadeTo(surf, 1.f);
+    }
+    m_hovered = surf;
+}
+
+SurfaceTransform *ScaleEffect::findTransform(ShellSurface *surface) const
+{
+    for (SurfaceTransform *tr: m_surfaces) {
+        if (tr->surface == surface) {
+            return tr;
         }
-    } else {
-        m_seat = nullptr;
-        m_grab->end();
-        Shell::instance()->showPanels();
     }
+    return nullptr;
 }
 
 void ScaleEffect::end(ShellSurface *surface)
@@ -260,31 +304,47 @@ void ScaleEffect::addedSurface(ShellSurface *surface)
 
         tr->cx = tr->cy = 0;
         tr->cs = 1.f;
+        tr->tx = tr->ty = 0;
+        tr->ts = 1.f;
 
         m_surfaces.push_back(tr);
 
-        if (m_scaled) {
-            m_scaled = false;
-            run(m_seat);
+        if (m_scaled && isInLayout(tr)) {
+            enter(tr);
+            layout();
         }
     }
 }
 
 void ScaleEffect::removedSurface(ShellSurface *surface)
 {
-    for (auto i = m_surfaces.begin(); i != m_surfaces.end(); ++i) {
-        if ((*i)->surface == surface) {
-            delete *i;
-            m_surfaces.erase(i);
-            break;
-        }
+    SurfaceTransform *tr = findTransform(surface);
+    if (!tr) {
+        return;
     }
 
-    if (m_scaled) {
-        if (!m_surfaces.empty()) {
-            m_scaled = false;
+    m_surfaces.remove(tr);
+    if (m_hovered == tr) {
+        m_hovered = nullptr;
+    }
+    delete tr;
+
+    if (!m_scaled) {
+        return;
+    }
+
+    bool empty = true;
+    for (SurfaceTransform *surf: m_surfaces) {
+        if (isInLayout(surf)) {
+            empty = false;
+            break;
         }
+    }
+    if (empty) {
         run(m_seat);
+        binding("Toggle")->releaseToggle();
+    } else {
+        layout();
     }
 }
 
@@ -22,10 +22,11 @@
 
 #include "effect.h"
 #include "binding.h"
+#include "animation.h"
 
 class ShellGrab;
-class Animation;
 class Binding;
+struct SurfaceTransform;
 
 class ScaleEffect : public Effect
 {
@@ -57,12 +58,20 @@ private:
     void run(struct weston_seat *seat, uint32_t time, uint32_t key);
     void run(weston_seat *seat, uint32_t time, Binding::HotSpot hs);
     void end(ShellSurface *surface);
+    bool isInLayout(SurfaceTransform *surf) const;
+    void enter(SurfaceTransform *surf);
+    void layout();
+    void moveTo(SurfaceTransform *surf, float scale, int x, int y, Animation::Flags flags = Animation::Flags::None);
+    void fadeTo(SurfaceTransform *surf, float alpha);
+    void setHovered(SurfaceTransform *surf);
+    SurfaceTransform *findTransform(ShellSurface *surface) const;
 
     bool m_scaled;
     std::list<struct SurfaceTransform *> m_surfaces;
     struct weston_seat *m_seat;
     struct Grab *m_grab;
     ShellSurface *m_chosenSurface;
+    SurfaceTransform *m_hovered;
 
     friend Grab;
 };
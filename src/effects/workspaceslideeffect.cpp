@@ -0,0 +1,156 @@
+/*
+ * Copyright 2014  Giulio Camuffo <giuliocamuffo@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "workspaceslideeffect.h"
+#include "animationcurve.h"
+#include "workspace.h"
+#include "transform.h"
+#include "shell.h"
+
+const int SLIDE_DURATION = 250;
+
+WorkspaceSlideEffect::WorkspaceSlideEffect()
+                    : Effect()
+                    , m_from(nullptr)
+                    , m_to(nullptr)
+                    , m_start(0)
+                    , m_offset(0)
+                    , m_distance(0)
+{
+    m_animation.updateSignal->connect(this, &WorkspaceSlideEffect::update);
+    m_animation.doneSignal->connect(this, &WorkspaceSlideEffect::done);
+    m_animation.setCurve(InOutQuadCurve());
+    Shell::instance()->workspaceSwitchedSignal.connect(this, &WorkspaceSlideEffect::switched);
+}
+
+WorkspaceSlideEffect::~WorkspaceSlideEffect()
+{
+    Shell::instance()->workspaceSwitchedSignal.disconnect(this, &WorkspaceSlideEffect::switched);
+    if (m_animation.isRunning()) {
+        m_animation.stop();
+        done();
+    }
+}
+
+void WorkspaceSlideEffect::switched(Workspace *from, Workspace *to)
+{
+    weston_output *output = to->output();
+    int distance = to->number() > from->number() ? output->width : -output->width;
+    int start = distance;
+
+    if (m_animation.isRunning()) {
+        m_animation.stop();
+        // Keep going from where the old slide is, if the workspace that
+        // is going away now is the one that was coming in
+        if (from == m_to) {
+            start = m_offset + distance;
+        }
+        if (m_from != to) {
+            m_from->remove();
+        }
+        reset();
+    }
+
+    m_from = from;
+    m_to = to;
+    m_start = start;
+    m_distance = distance;
+    m_from->destroyedSignal.connect(this, &WorkspaceSlideEffect::workspaceDestroyed);
+    m_to->destroyedSignal.connect(this, &WorkspaceSlideEffect::workspaceDestroyed);
+
+    // The old workspace was just removed, keep it visible while it slides out
+    m_from->insert(m_to);
+
+    m_animation.setStart(0.f);
+    m_animation.setTarget(1.f);
+    m_animation.run(output, SLIDE_DURATION, Animation::Flags::SendDone);
+}
+
+void WorkspaceSlideEffect::update(float value)
+{
+    m_offset = m_start * (1.f - value);
+
+    Transform to;
+    to.translate(m_offset, 0, 0);
+    m_to->setTransform(to);
+
+    Transform from;
+    from.translate(m_offset - m_distance, 0, 0);
+    m_from->setTransform(from);
+}
+
+void WorkspaceSlideEffect::done()
+{
+    m_from->remove();
+    reset();
+}
+
+void WorkspaceSlideEffect::workspaceDestroyed(Workspace *ws)
+{
+    m_animation.stop();
+    Workspace *other = ws == m_from ? m_to : m_from;
+    if (other == m_from) {
+        other->remove();
+    }
+    other->setTransform(Transform());
+    other->destroyedSignal.disconnect(this, &WorkspaceSlideEffect::workspaceDestroyed);
+    m_from = m_to = nullptr;
+}
+
+void WorkspaceSlideEffect::reset()
+{
+    m_from->setTransform(Transform());
+    m_to->setTransform(Transform());
+    m_from->destroyedSignal.disconnect(this, &WorkspaceSlideEffect::workspaceDestroyed);
+    m_to->destroyedSignal.disconnect(this, &WorkspaceSlideEffect::workspaceDestroyed);
+    m_from = m_to = nullptr;
+}
+
+
+WorkspaceSlideEffect::Settings::Settings()
+                    : Effect::Settings()
+                    , m_effect(nullptr)
+{
+}
+
+WorkspaceSlideEffect::Settings::~Settings()
+{
+    delete m_effect;
+}
+
+void WorkspaceSlideEffect::Settings::set(const std::string &name, int v)
+{
+    if (name == "enabled") {
+        if (v && !m_effect) {
+            m_effect = new WorkspaceSlideEffect;
+        } else if (!v) {
+            delete m_effect;
+            m_effect = nullptr;
+        }
+    }
+}
+
+void WorkspaceSlideEffect::Settings::unSet(const std::string &name)
+{
+    if (name == "enabled") {
+        delete m_effect;
+        m_effect = nullptr;
+    }
+}
+
+SETTINGS(workspaceslide_effect, WorkspaceSlideEffect::Settings)
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2014  Giulio Camuffo <giuliocamuffo@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef WORKSPACESLIDEEFFECT_H
+#define WORKSPACESLIDEEFFECT_H
+
+#include "effect.h"
+#include "animation.h"
+
+class Workspace;
+
+/*
+ * Slides the workspaces in and out when switching between them. Only the
+ * transforms of the two workspace roots are animated, so the cost doesn't
+ * depend on the number of windows. Switching again while sliding starts a
+ * new slide from where the current one got to.
+ */
+class WorkspaceSlideEffect : public Effect
+{
+public:
+    class Settings : public Effect::Settings
+    {
+    public:
+        Settings();
+        ~Settings();
+
+        virtual void unSet(const std::string &name) override;
+        virtual void set(const std::string &name, int v) override;
+
+    private:
+        WorkspaceSlideEffect *m_effect;
+    };
+
+    WorkspaceSlideEffect();
+    ~WorkspaceSlideEffect();
+
+private:
+    void switched(Workspace *from, Workspace *to);
+    void update(float value);
+    void done();
+    void workspaceDestroyed(Workspace *ws);
+    void reset();
+
+    Animation m_animation;
+    Workspace *m_from;
+    Workspace *m_to;
+    // offset of m_to when the slide started, and the current one
+    int m_start;
+    int m_offset;
+    // distance between the two workspaces, negative if m_to is on the left
+    int m_distance;
+};
+
+#endif
@@ -0,0 +1,114 @@
+/*
+ * Copyright 2014  Giulio Camuffo <giuliocamuffo@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <unistd.h>
+#include <algorithm>
+#include <stdint.h>
+#include <sys/eventfd.h>
+
+#include <wayland-server.h>
+
+#include "executor.h"
+
+Executor::Executor(wl_event_loop *loop, int threads)
+        : m_quit(false)
+{
+    m_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    m_source = wl_event_loop_add_fd(loop, m_fd, WL_EVENT_READABLE, [](int fd, uint32_t mask, void *data) {
+        static_cast<Executor *>(data)->dispatch();
+        return 0;
+    }, this);
+
+    if (threads <= 0) {
+        // Leave a core to the compositor and the clients
+        int cores = std::thread::hardware_concurrency();
+        threads = std::max(1, std::min(4, cores - 1));
+    }
+    for (int i = 0; i < threads; ++i) {
+        m_threads.push_back(std::thread(&Executor::worker, this));
+    }
+}
+
+Executor::~Executor()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_condition.notify_all();
+    for (std::thread &t: m_threads) {
+        t.join();
+    }
+
+    // The done functions still pending are dropped, their owners may be gone
+    wl_event_source_remove(m_source);
+    close(m_fd);
+}
+
+void Executor::run(const std::function<void ()> &work, const std::function<void ()> &done)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back({ work, done });
+    }
+    m_condition.notify_one();
+}
+
+void Executor::worker()
+{
+    while (true) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_quit || !m_queue.empty(); });
+            if (m_queue.empty()) {
+                return;
+            }
+            task = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+
+        task.work();
+
+        if (task.done) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_quit) {
+                m_finished.push_back(std::move(task.done));
+                uint64_t one = 1;
+                ssize_t ret = write(m_fd, &one, sizeof(one));
+                (void)ret;
+            }
+        }
+    }
+}
+
+void Executor::dispatch()
+{
+    uint64_t count;
+    ssize_t ret = read(m_fd, &count, sizeof(count));
+    (void)ret;
+
+    std::deque<std::function<void ()>> finished;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        finished.swap(m_finished);
+    }
+    for (auto &done: finished) {
+        done();
+    }
+}
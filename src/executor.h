@@ -0,0 +1,79 @@
+/*
+ * Copyright 2014  Giulio Camuffo <giuliocamuffo@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+
+struct wl_event_loop;
+struct wl_event_source;
+
+/*
+ * A fixed pool of worker threads for the work that must not stall the
+ * compositor thread. The work functions run on a worker, and must not touch
+ * any compositor or shell state. The done functions are called back on the
+ * compositor thread, from the event loop, once their work is finished.
+ * The work already queued when the executor is destroyed is still carried
+ * out, e.g. to not lose a save at exit, but the done functions are dropped.
+ */
+class Executor
+{
+public:
+    Executor(wl_event_loop *loop, int threads = 0);
+    ~Executor();
+
+    void run(const std::function<void ()> &work, const std::function<void ()> &done = std::function<void ()>());
+    /* Like run(), but the value returned by the work is given to done. */
+    template<class T>
+    void compute(const std::function<T ()> &work, const std::function<void (T &)> &done);
+
+private:
+    struct Task {
+        std::function<void ()> work;
+        std::function<void ()> done;
+    };
+
+    void worker();
+    void dispatch();
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<Task> m_queue;
+    std::deque<std::function<void ()>> m_finished;
+    bool m_quit;
+    int m_fd;
+    wl_event_source *m_source;
+};
+
+template<class T>
+void Executor::compute(const std::function<T ()> &work, const std::function<void (T &)> &done)
+{
+    std::shared_ptr<T> result = std::make_shared<T>();
+    run([result, work]() { *result = work(); },
+        [result, done]() { done(*result); });
+}
+
+#endif
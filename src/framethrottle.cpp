@@ -0,0 +1,100 @@
+/*
+ * Copyright 2014  Giulio Camuffo <giuliocamuffo@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <weston/compositor.h>
+
+#include "framethrottle.h"
+
+FrameThrottle::FrameThrottle(weston_surface *surface, int interval)
+             : m_surface(surface)
+             , m_timer(interval)
+{
+    wl_list_init(&m_callbacks);
+    m_timer.triggered.connect(this, &FrameThrottle::release);
+}
+
+FrameThrottle::~FrameThrottle()
+{
+    // The surface may be gone already, like weston just destroy the callbacks
+    weston_frame_callback *cb, *next;
+    wl_list_for_each_safe(cb, next, &m_callbacks, link) {
+        wl_resource_destroy(cb->resource);
+    }
+}
+
+void FrameThrottle::throttle(const void *owner)
+{
+    if (!m_owners.insert(owner).second || m_owners.size() > 1) {
+        return;
+    }
+
+    // The callbacks already committed would wait for a repaint of the
+    // surface, which may not come if it is not rendered anymore
+    if (!wl_list_empty(&m_surface->frame_callback_list)) {
+        wl_list_insert_list(m_callbacks.prev, &m_surface->frame_callback_list);
+        wl_list_init(&m_surface->frame_callback_list);
+        m_timer.start();
+    }
+}
+
+void FrameThrottle::unthrottle(const void *owner)
+{
+    if (m_owners.erase(owner) && m_owners.empty()) {
+        flush();
+    }
+}
+
+void FrameThrottle::setInterval(int interval)
+{
+    m_timer.setInterval(interval);
+}
+
+void FrameThrottle::commit()
+{
+    if (!isThrottled() || wl_list_empty(&m_surface->pending.frame_callback_list)) {
+        return;
+    }
+
+    wl_list_insert_list(m_callbacks.prev, &m_surface->pending.frame_callback_list);
+    wl_list_init(&m_surface->pending.frame_callback_list);
+    m_timer.start();
+}
+
+void FrameThrottle::release()
+{
+    m_timer.stop();
+
+    uint32_t time = weston_compositor_get_time();
+    weston_frame_callback *cb, *next;
+    wl_list_for_each_safe(cb, next, &m_callbacks, link) {
+        wl_callback_send_done(cb->resource, time);
+        wl_resource_destroy(cb->resource);
+    }
+}
+
+void FrameThrottle::flush()
+{
+    m_timer.stop();
+    if (wl_list_empty(&m_callbacks)) {
+        return;
+    }
+
+    // Let them go out with the next repaint, as usual
+    wl_list_insert_list(m_surface->frame_callback_list.prev, &m_callbacks);
+    wl_list_init(&m_callbacks);
+    weston_surface_schedule_repaint(m_surface);
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2014  Giulio Camuffo <giuliocamuffo@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAMETHROTTLE_H
+#define FRAMETHROTTLE_H
+
+#include <unordered_set>
+
+#include "utils.h"
+
+/*
+ * Slows down the frame callbacks of a surface nobody can see. While at least
+ * one owner keeps it throttled, the frame callbacks committed by the client
+ * are held back and released every interval ms instead of on every repaint.
+ * commit() must be called from the configure hook of the surface, which weston
+ * calls before moving the pending callbacks to the surface. Weston has no hook
+ * for the commits which don't attach a buffer, so the callbacks committed
+ * alone are not held back, they go out with the next repaint as usual.
+ */
+class FrameThrottle
+{
+public:
+    static const int DefaultInterval = 1000;
+
+    FrameThrottle(weston_surface *surface, int interval = DefaultInterval);
+    ~FrameThrottle();
+
+    void throttle(const void *owner);
+    void unthrottle(const void *owner);
+    inline bool isThrottled() const { return !m_owners.empty(); }
+
+    void setInterval(int interval);
+    void commit();
+
+private:
+    void release();
+    void flush();
+
+    weston_surface *m_surface;
+    std::unordered_set<const void *> m_owners;
+    wl_list m_callbacks;
+    Timer m_timer;
+};
+
+#endif
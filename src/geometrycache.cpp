@@ -0,0 +1,167 @@
+/*
+ * Copyright 2014  Giulio Camuffo <giuliocamuffo@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "geometrycache.h"
+
+static const uint32_t Magic = 0x3243474e; // "NGC2"
+static const uint32_t HeaderFields = 4;
+
+struct GeometryCache::Entry {
+    uint32_t stamp; // 0 for a free entry
+    uint32_t classHash;
+    int32_t x, y;
+    int32_t width, height;
+    int32_t maximized;
+    int32_t workspace;
+    int32_t padding[2];
+};
+
+const size_t GeometryCache::FileSize = HeaderFields * sizeof(uint32_t) + MaxEntries * sizeof(Entry);
+
+// FNV-1a
+static uint32_t hash(const std::string &s)
+{
+    uint32_t h = 2166136261u;
+    for (unsigned char c: s) {
+        h = (h ^ c) * 16777619u;
+    }
+    return h ? h : 1;
+}
+
+static std::string cachePath()
+{
+    std::string dir;
+    if (const char *cache = getenv("XDG_CACHE_HOME")) {
+        dir = cache;
+    } else if (const char *home = getenv("HOME")) {
+        dir = std::string(home) + "/.cache";
+    } else {
+        return std::string();
+    }
+    mkdir(dir.c_str(), 0700);
+    dir += "/nuclear";
+    mkdir(dir.c_str(), 0700);
+    return dir + "/geometry";
+}
+
+GeometryCache::GeometryCache()
+             : m_entries(nullptr)
+             , m_clock(nullptr)
+{
+    static_assert(sizeof(Entry) == 40, "the entries must keep their file layout");
+
+    std::string path = cachePath();
+    int fd = path.empty() ? -1 : open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open the geometry cache: %s\n", strerror(errno));
+        return;
+    }
+
+    struct stat st;
+    bool fresh = fstat(fd, &st) < 0 || (size_t)st.st_size != FileSize;
+    if (fresh && (ftruncate(fd, 0) < 0 || ftruncate(fd, FileSize) < 0)) {
+        fprintf(stderr, "Failed to resize the geometry cache: %s\n", strerror(errno));
+        close(fd);
+        return;
+    }
+
+    void *data = mmap(nullptr, FileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Failed to map the geometry cache: %s\n", strerror(errno));
+        return;
+    }
+
+    uint32_t *header = static_cast<uint32_t *>(data);
+    if (header[0] != Magic || header[1] != MaxEntries) {
+        memset(data, 0, FileSize);
+        header[0] = Magic;
+        header[1] = MaxEntries;
+    }
+    m_clock = &header[2];
+    m_entries = reinterpret_cast<Entry *>(header + HeaderFields);
+}
+
+GeometryCache::~GeometryCache()
+{
+    if (m_entries) {
+        munmap(reinterpret_cast<uint32_t *>(m_entries) - HeaderFields, FileSize);
+    }
+}
+
+bool GeometryCache::lookup(const std::string &cls, Geometry *geometry)
+{
+    if (!m_entries || cls.empty()) {
+        return false;
+    }
+
+    uint32_t ch = hash(cls);
+    Entry *found = nullptr;
+    for (int i = 0; i < MaxEntries; ++i) {
+        Entry *e = &m_entries[i];
+        if (e->stamp && e->classHash == ch) {
+            found = e;
+            break;
+        }
+    }
+    if (!found) {
+        return false;
+    }
+
+    found->stamp = ++*m_clock;
+    *geometry = { found->x, found->y, found->width, found->height, found->maximized != 0, found->workspace };
+    return true;
+}
+
+void GeometryCache::store(const std::string &cls, const Geometry &geometry)
+{
+    if (!m_entries || cls.empty() || geometry.width <= 0 || geometry.height <= 0) {
+        return;
+    }
+
+    uint32_t ch = hash(cls);
+    Entry *entry = &m_entries[0];
+    for (int i = 0; i < MaxEntries; ++i) {
+        Entry *e = &m_entries[i];
+        if (e->stamp && e->classHash == ch) {
+            entry = e;
+            break;
+        }
+        if (e->stamp < entry->stamp) {
+            entry = e;
+        }
+    }
+
+    entry->classHash = ch;
+    entry->x = geometry.x;
+    entry->y = geometry.y;
+    entry->width = geometry.width;
+    entry->height = geometry.height;
+    entry->maximized = geometry.maximized;
+    entry->workspace = geometry.workspace;
+    entry->stamp = ++*m_clock;
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2014  Giulio Camuffo <giuliocamuffo@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef GEOMETRYCACHE_H
+#define GEOMETRYCACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <string>
+
+/*
+ * Remembers where the last window of every application was, keyed by its
+ * class (the app id) alone, as titles change all the time, so that new
+ * windows can be configured to their last size and position before they map. The entries live in a
+ * small fixed size file mapped in memory, in $XDG_CACHE_HOME/nuclear, so a
+ * lookup or an update never makes a syscall. When full, the least recently
+ * used entry is replaced.
+ */
+class GeometryCache
+{
+public:
+    static const int MaxEntries = 256;
+
+    struct Geometry {
+        int32_t x, y;
+        int32_t width, height;
+        bool maximized;
+        int32_t workspace;
+    };
+
+    GeometryCache();
+    ~GeometryCache();
+
+    bool lookup(const std::string &cls, Geometry *geometry);
+    void store(const std::string &cls, const Geometry &geometry);
+
+private:
+    struct Entry;
+    static const size_t FileSize;
+
+    Entry *m_entries;
+    uint32_t *m_clock;
+};
+
+#endif
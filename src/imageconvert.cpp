@@ -0,0 +1,174 @@
+/*
+ * Copyright 2014  Giulio Camuffo <giuliocamuffo@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "imageconvert.h"
+
+static void swapRow(const uint8_t *src, uint8_t *dst, int width)
+{
+    int x = 0;
+
+#ifdef __SSE2__
+    const __m128i ga = _mm_set1_epi32(0xff00ff00);
+    const __m128i low = _mm_set1_epi32(0x000000ff);
+    for (; x + 4 <= width; x += 4) {
+        __m128i p = _mm_loadu_si128((const __m128i *)(src + x * 4));
+        __m128i r = _mm_and_si128(_mm_srli_epi32(p, 16), low);
+        __m128i b = _mm_slli_epi32(_mm_and_si128(p, low), 16);
+        _mm_storeu_si128((__m128i *)(dst + x * 4), _mm_or_si128(_mm_and_si128(p, ga), _mm_or_si128(r, b)));
+    }
+#endif
+
+    for (; x < width; ++x) {
+        dst[x * 4 + 0] = src[x * 4 + 2];
+        dst[x * 4 + 1] = src[x * 4 + 1];
+        dst[x * 4 + 2] = src[x * 4 + 0];
+        dst[x * 4 + 3] = src[x * 4 + 3];
+    }
+}
+
+static void packRow(const uint8_t *src, uint8_t *dst, int width, bool swap)
+{
+    const int r = swap ? 2 : 0;
+    const int b = swap ? 0 : 2;
+    for (int x = 0; x < width; ++x) {
+        dst[x * 3 + 0] = src[x * 4 + r];
+        dst[x * 3 + 1] = src[x * 4 + 1];
+        dst[x * 3 + 2] = src[x * 4 + b];
+    }
+}
+
+void convertImage(const uint8_t *src, int width, int height, int srcStride, PixelLayout srcLayout,
+                  uint8_t *dst, int dstStride, PixelLayout dstLayout, bool flip)
+{
+    const bool srcBGR = srcLayout == PixelLayout::BGRA;
+    const bool dstBGR = dstLayout == PixelLayout::BGRA || dstLayout == PixelLayout::BGR;
+    const bool swap = srcBGR != dstBGR;
+
+    for (int y = 0; y < height; ++y) {
+        const uint8_t *in = src + (flip ? height - 1 - y : y) * srcStride;
+        uint8_t *out = dst + y * dstStride;
+
+        if (bytesPerPixel(dstLayout) == 3) {
+            packRow(in, out, width, swap);
+        } else if (swap) {
+            swapRow(in, out, width);
+        } else {
+            memcpy(out, in, width * 4);
+        }
+    }
+}
+
+enum {
+    QOI_OP_INDEX = 0x00,
+    QOI_OP_DIFF = 0x40,
+    QOI_OP_LUMA = 0x80,
+    QOI_OP_RUN = 0xc0,
+    QOI_OP_RGB = 0xfe
+};
+
+static void put32(std::vector<uint8_t> *out, uint32_t v)
+{
+    out->push_back(v >> 24);
+    out->push_back(v >> 16);
+    out->push_back(v >> 8);
+    out->push_back(v);
+}
+
+void encodeQoi(const uint8_t *src, int width, int height, int srcStride, PixelLayout srcLayout,
+               bool flip, std::vector<uint8_t> *out)
+{
+    const int r = srcLayout == PixelLayout::BGRA ? 2 : 0;
+    const int b = srcLayout == PixelLayout::BGRA ? 0 : 2;
+
+    // Worst case, every pixel is a QOI_OP_RGB
+    out->reserve(out->size() + 14 + width * height * 4 + 8);
+    out->push_back('q');
+    out->push_back('o');
+    out->push_back('i');
+    out->push_back('f');
+    put32(out, width);
+    put32(out, height);
+    out->push_back(3); // RGB, the outputs are opaque
+    out->push_back(0); // sRGB
+
+    // The alpha is always 255, so it is left out of the index hash
+    uint8_t index[64][3];
+    bool used[64];
+    memset(used, 0, sizeof(used));
+    uint8_t prev[3] = { 0, 0, 0 };
+    int run = 0;
+
+    for (int y = 0; y < height; ++y) {
+        const uint8_t *in = src + (flip ? height - 1 - y : y) * srcStride;
+
+        for (int x = 0; x < width; ++x, in += 4) {
+            const uint8_t px[3] = { in[r], in[1], in[b] };
+
+            if (px[0] == prev[0] && px[1] == prev[1] && px[2] == prev[2]) {
+                if (++run == 62) {
+                    out->push_back(QOI_OP_RUN | (run - 1));
+                    run = 0;
+                }
+                continue;
+            }
+            if (run > 0) {
+                out->push_back(QOI_OP_RUN | (run - 1));
+                run = 0;
+            }
+
+            int hash = (px[0] * 3 + px[1] * 5 + px[2] * 7 + 255 * 11) % 64;
+            if (used[hash] && memcmp(index[hash], px, 3) == 0) {
+                out->push_back(QOI_OP_INDEX | hash);
+            } else {
+                memcpy(index[hash], px, 3);
+                used[hash] = true;
+
+                int8_t dr = px[0] - prev[0];
+                int8_t dg = px[1] - prev[1];
+                int8_t db = px[2] - prev[2];
+                int8_t dgr = dr - dg;
+                int8_t dgb = db - dg;
+
+                if (dr > -3 && dr < 2 && dg > -3 && dg < 2 && db > -3 && db < 2) {
+                    out->push_back(QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+                } else if (dgr > -9 && dgr < 8 && dg > -33 && dg < 32 && dgb > -9 && dgb < 8) {
+                    out->push_back(QOI_OP_LUMA | (dg + 32));
+                    out->push_back((dgr + 8) << 4 | (dgb + 8));
+                } else {
+                    out->push_back(QOI_OP_RGB);
+                    out->push_back(px[0]);
+                    out->push_back(px[1]);
+                    out->push_back(px[2]);
+                }
+            }
+            memcpy(prev, px, 3);
+        }
+    }
+    if (run > 0) {
+        out->push_back(QOI_OP_RUN | (run - 1));
+    }
+
+    static const uint8_t padding[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+    out->insert(out->end(), padding, padding + 8);
+}
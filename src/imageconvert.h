@@ -0,0 +1,50 @@
+/*
+ * Copyright 2014  Giulio Camuffo <giuliocamuffo@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef IMAGECONVERT_H
+#define IMAGECONVERT_H
+
+#include <stdint.h>
+#include <vector>
+
+/* The order of the channels of a pixel in memory. */
+enum class PixelLayout {
+    BGRA,
+    RGBA,
+    BGR,
+    RGB
+};
+
+inline int bytesPerPixel(PixelLayout layout) { return layout == PixelLayout::BGRA || layout == PixelLayout::RGBA ? 4 : 3; }
+
+/*
+ * Convert a 32 bit per pixel image, in BGRA or RGBA order, to the given
+ * layout. If flip is true the rows are written bottom to top, e.g. to undo
+ * the flip of a GL readback. The 32 bit conversions use SSE2 where available.
+ */
+void convertImage(const uint8_t *src, int width, int height, int srcStride, PixelLayout srcLayout,
+                  uint8_t *dst, int dstStride, PixelLayout dstLayout, bool flip);
+
+/*
+ * Encode a 32 bit per pixel image, in BGRA or RGBA order, as an opaque QOI
+ * image appended to out. See https://qoiformat.org for the format.
+ */
+void encodeQoi(const uint8_t *src, int width, int height, int srcStride, PixelLayout srcLayout,
+               bool flip, std::vector<uint8_t> *out);
+
+#endif
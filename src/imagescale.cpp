@@ -0,0 +1,128 @@
+/*
+ * Copyright 2014  Giulio Camuffo <giuliocamuffo@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "imagescale.h"
+
+static void halve(const uint8_t *src, int width, int height, int stride, uint8_t *dst, int dstStride)
+{
+    const int w = width / 2;
+    const int h = height / 2;
+
+    for (int y = 0; y < h; ++y) {
+        const uint8_t *r0 = src + 2 * y * stride;
+        const uint8_t *r1 = r0 + stride;
+        uint8_t *out = dst + y * dstStride;
+        int x = 0;
+
+#ifdef __SSE2__
+        // 4 destination pixels at a time, from two rows of 8 pixels
+        for (; x + 4 <= w; x += 4) {
+            __m128i a0 = _mm_loadu_si128((const __m128i *)(r0 + x * 8));
+            __m128i a1 = _mm_loadu_si128((const __m128i *)(r0 + x * 8 + 16));
+            __m128i b0 = _mm_loadu_si128((const __m128i *)(r1 + x * 8));
+            __m128i b1 = _mm_loadu_si128((const __m128i *)(r1 + x * 8 + 16));
+            __m128 v0 = _mm_castsi128_ps(_mm_avg_epu8(a0, b0));
+            __m128 v1 = _mm_castsi128_ps(_mm_avg_epu8(a1, b1));
+            __m128i even = _mm_castps_si128(_mm_shuffle_ps(v0, v1, _MM_SHUFFLE(2, 0, 2, 0)));
+            __m128i odd = _mm_castps_si128(_mm_shuffle_ps(v0, v1, _MM_SHUFFLE(3, 1, 3, 1)));
+            _mm_storeu_si128((__m128i *)(out + x * 4), _mm_avg_epu8(even, odd));
+        }
+#endif
+
+        for (; x < w; ++x) {
+            const uint8_t *p = r0 + x * 8;
+            const uint8_t *q = r1 + x * 8;
+            for (int c = 0; c < 4; ++c) {
+                out[x * 4 + c] = (p[c] + p[c + 4] + q[c] + q[c + 4] + 2) / 4;
+            }
+        }
+    }
+}
+
+static void boxFilter(const uint8_t *src, int width, int height, int stride,
+                      uint8_t *dst, int dstWidth, int dstHeight, int dstStride, bool swapRB)
+{
+    const int r = swapRB ? 2 : 0;
+    const int b = swapRB ? 0 : 2;
+
+    for (int y = 0; y < dstHeight; ++y) {
+        int y0 = y * height / dstHeight;
+        int y1 = std::max(y0 + 1, (y + 1) * height / dstHeight);
+        uint8_t *out = dst + y * dstStride;
+
+        for (int x = 0; x < dstWidth; ++x) {
+            int x0 = x * width / dstWidth;
+            int x1 = std::max(x0 + 1, (x + 1) * width / dstWidth);
+
+            uint32_t sum[4] = { 0, 0, 0, 0 };
+            for (int sy = y0; sy < y1; ++sy) {
+                const uint8_t *p = src + sy * stride + x0 * 4;
+                for (int sx = x0; sx < x1; ++sx, p += 4) {
+                    sum[0] += p[0];
+                    sum[1] += p[1];
+                    sum[2] += p[2];
+                    sum[3] += p[3];
+                }
+            }
+            uint32_t n = (y1 - y0) * (x1 - x0);
+            out[x * 4 + 0] = (sum[r] + n / 2) / n;
+            out[x * 4 + 1] = (sum[1] + n / 2) / n;
+            out[x * 4 + 2] = (sum[b] + n / 2) / n;
+            out[x * 4 + 3] = (sum[3] + n / 2) / n;
+        }
+    }
+}
+
+void downscaleImage(const uint8_t *src, int srcWidth, int srcHeight, int srcStride,
+                    uint8_t *dst, int dstWidth, int dstHeight, int dstStride,
+                    bool swapRB, int *width, int *height)
+{
+    for (int y = 0; y < dstHeight; ++y) {
+        memset(dst + y * dstStride, 0, dstWidth * 4);
+    }
+
+    float scale = std::min(std::min((float)dstWidth / srcWidth, (float)dstHeight / srcHeight), 1.f);
+    int w = std::max((int)(srcWidth * scale + 0.5f), 1);
+    int h = std::max((int)(srcHeight * scale + 0.5f), 1);
+    *width = w;
+    *height = h;
+
+    std::vector<uint8_t> buffers[2];
+    int current = 0;
+    while (srcWidth >= 2 * w && srcHeight >= 2 * h) {
+        std::vector<uint8_t> &next = buffers[current];
+        next.resize((srcWidth / 2) * (srcHeight / 2) * 4);
+        halve(src, srcWidth, srcHeight, srcStride, next.data(), (srcWidth / 2) * 4);
+
+        srcWidth /= 2;
+        srcHeight /= 2;
+        srcStride = srcWidth * 4;
+        src = next.data();
+        current = !current;
+    }
+
+    boxFilter(src, srcWidth, srcHeight, srcStride, dst, w, h, dstStride, swapRB);
+}
@@ -0,0 +1,38 @@
+/*
+ * Copyright 2014  Giulio Camuffo <giuliocamuffo@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef IMAGESCALE_H
+#define IMAGESCALE_H
+
+#include <stdint.h>
+
+/*
+ * Scale a 32 bit per pixel image down to fit in the destination, keeping its
+ * aspect ratio and never making it bigger. The image is put in the top left
+ * corner and the rest of the destination is cleared. The image is halved
+ * with a 2x2 box filter, using SSE2 where available, as long as it stays at
+ * least twice as big as the target size, and a last box filter pass brings
+ * it to the final size. If swapRB is true the first and third bytes of
+ * every pixel are swapped, e.g. to go from RGBA to BGRA.
+ * The size of the scaled image is returned in width and height.
+ */
+void downscaleImage(const uint8_t *src, int srcWidth, int srcHeight, int srcStride,
+                    uint8_t *dst, int dstWidth, int dstHeight, int dstStride,
+                    bool swapRB, int *width, int *height);
+
+#endif
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2014  Giulio Camuffo <giuliocamuffo@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+
+#include "latencyhistogram.h"
+
+LatencyHistogram::LatencyHistogram()
+                : m_recentCount(0)
+                , m_recentPos(0)
+                , m_count(0)
+                , m_min(0)
+                , m_max(0)
+                , m_sum(0)
+{
+    memset(m_buckets, 0, sizeof(m_buckets));
+}
+
+void LatencyHistogram::addSample(uint32_t ms)
+{
+    // bucket i holds the samples in [2^(i-1), 2^i), bucket 0 the ones < 1
+    int b = 0;
+    for (uint32_t v = ms; v && b < Buckets - 1; v >>= 1) {
+        ++b;
+    }
+    ++m_buckets[b];
+
+    m_min = m_count ? std::min(m_min, ms) : ms;
+    m_max = std::max(m_max, ms);
+    m_sum += ms;
+    ++m_count;
+
+    m_recent[m_recentPos] = ms;
+    m_recentPos = (m_recentPos + 1) % RecentSamples;
+    if (m_recentCount < RecentSamples) {
+        ++m_recentCount;
+    }
+}
+
+void LatencyHistogram::resetRecent()
+{
+    m_recentCount = 0;
+    m_recentPos = 0;
+}
+
+uint32_t LatencyHistogram::mean() const
+{
+    return m_count ? m_sum / m_count : 0;
+}
+
+uint32_t LatencyHistogram::percentile(float p) const
+{
+    if (m_recentCount == 0) {
+        return 0;
+    }
+
+    uint32_t sorted[RecentSamples];
+    std::copy(m_recent, m_recent + m_recentCount, sorted);
+    int n = std::min(m_recentCount - 1, (int)(p * m_recentCount));
+    std::nth_element(sorted, sorted + n, sorted + m_recentCount);
+    return sorted[n];
+}
+
+std::string LatencyHistogram::toString() const
+{
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%u samples, min %ums, mean %ums, max %ums, recent p50 %ums p99 %ums;",
+             m_count, m_min, mean(), m_max, percentile(0.5), percentile(0.99));
+    std::string str = buf;
+
+    for (int i = 0; i < Buckets; ++i) {
+        if (!m_buckets[i]) {
+            continue;
+        }
+        if (i == Buckets - 1) {
+            snprintf(buf, sizeof(buf), " >=%ums: %u", 1u << (i - 1), m_buckets[i]);
+        } else {
+            snprintf(buf, sizeof(buf), " <%ums: %u", 1u << i, m_buckets[i]);
+        }
+        str += buf;
+    }
+    return str;
+}
+
+uint32_t LatencyHistogram::now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright 2014  Giulio Camuffo <giuliocamuffo@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <stdint.h>
+
+#include <string>
+
+/*
+ * Collects round-trip latencies, in milliseconds. It keeps a histogram
+ * with power of two buckets over the whole lifetime, and the last
+ * RecentSamples samples for computing percentiles of the recent behaviour.
+ */
+class LatencyHistogram
+{
+public:
+    static const int Buckets = 16;
+    static const int RecentSamples = 64;
+
+    LatencyHistogram();
+
+    void addSample(uint32_t ms);
+    // forget the recent samples, keeping the lifetime histogram
+    void resetRecent();
+
+    uint32_t count() const { return m_count; }
+    uint32_t recentCount() const { return m_recentCount; }
+    uint32_t min() const { return m_min; }
+    uint32_t max() const { return m_max; }
+    uint32_t mean() const;
+    uint32_t bucket(int i) const { return m_buckets[i]; }
+
+    /* The p-th percentile, with p in [0, 1], of the recent samples. */
+    uint32_t percentile(float p) const;
+
+    std::string toString() const;
+
+    /* Monotonic time in milliseconds, for timing the samples. */
+    static uint32_t now();
+
+private:
+    uint32_t m_buckets[Buckets];
+    uint32_t m_recent[RecentSamples];
+    int m_recentCount;
+    int m_recentPos;
+    uint32_t m_count;
+    uint32_t m_min;
+    uint32_t m_max;
+    uint64_t m_sum;
+};
+
+#endif
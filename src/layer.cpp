@@ -15,8 +15,24 @@
  * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+
 #include "layer.h"
 #include "shellsurface.h"
+#include "shell.h"
+
+// The layer which has the ones below it detached, if any
+static Layer *s_detaching = nullptr;
+
+// Layers are only moved around when none is detached, so that the ones put
+// next to a detached layer end up in the compositor list too.
+static void reattachDetached()
+{
+    if (s_detaching) {
+        s_detaching->reattachBelow();
+        weston_compositor_damage_all(Shell::compositor());
+    }
+}
 
 Layer::Layer()
      : m_below(nullptr)
@@ -25,39 +41,51 @@ Layer::Layer()
     wl_list_init(&m_layer.link);
 }
 
-void Layer::insert(struct weston_layer *below)
+Layer::~Layer()
+{
+    // Don't leave this layer in the detached ones, or them out of the list
+    if (s_detaching) {
+        s_detaching->reattachBelow();
+    }
+}
+
+void Layer::insert(struct weston_layer *below, bool damage)
 {
     if (below) {
+        reattachDetached();
         wl_list_remove(&m_layer.link);
         wl_list_insert(&below->link, &m_layer.link);
-        for (weston_view *v: *this) {
-            weston_surface_damage(v->surface);
+        if (damage) {
+            for (weston_view *v: *this) {
+                weston_surface_damage(v->surface);
+            }
         }
     }
 }
 
-void Layer::insert(Layer *below)
+void Layer::insert(Layer *below, bool damage)
 {
     if (below) {
-        wl_list_remove(&m_layer.link);
-        wl_list_insert(&below->m_layer.link, &m_layer.link);
-        for (weston_view *v: *this) {
-            weston_surface_damage(v->surface);
-        }
+        insert(&below->m_layer, damage);
     }
 }
 
-void Layer::remove()
+void Layer::remove(bool damage)
 {
-    hide();
+    hide(damage);
     m_below = nullptr;
 }
 
-void Layer::hide()
+void Layer::hide(bool damage)
 {
-    for (weston_view *v: *this) {
-        weston_view_damage_below(v);
-        weston_surface_schedule_repaint(v->surface);
+    // This also doesn't leave the layers below out of the compositor list
+    // with nothing covering them anymore
+    reattachDetached();
+    if (damage) {
+        for (weston_view *v: *this) {
+            weston_view_damage_below(v);
+            weston_surface_schedule_repaint(v->surface);
+        }
     }
     if (!wl_list_empty(&m_layer.link)) {
         m_below = m_layer.link.prev;
@@ -66,13 +94,75 @@ void Layer::hide()
     }
 }
 
+void Layer::detachBelow()
+{
+    if (isDetachedBelow() || wl_list_empty(&m_layer.link)) {
+        return;
+    }
+    reattachDetached();
+
+    wl_list *head = &Shell::compositor()->layer_list;
+    while (m_layer.link.next != head) {
+        weston_layer *layer = container_of(m_layer.link.next, weston_layer, link);
+        wl_list_remove(&layer->link);
+        wl_list_init(&layer->link);
+        m_detachedLayers.push_back(layer);
+    }
+    if (isDetachedBelow()) {
+        s_detaching = this;
+    }
+}
+
+void Layer::reattachBelow()
+{
+    // put them back right below this layer, in the same order
+    wl_list *prev = &m_layer.link;
+    for (weston_layer *layer: m_detachedLayers) {
+        wl_list_insert(prev, &layer->link);
+        prev = &layer->link;
+    }
+    m_detachedLayers.clear();
+    if (s_detaching == this) {
+        s_detaching = nullptr;
+    }
+}
+
+static void releaseFrameCallbacks(weston_surface *surface, uint32_t time)
+{
+    weston_frame_callback *cb, *next;
+    wl_list_for_each_safe(cb, next, &surface->frame_callback_list, link) {
+        wl_callback_send_done(cb->resource, time);
+        wl_resource_destroy(cb->resource);
+    }
+
+    weston_subsurface *sub;
+    wl_list_for_each(sub, &surface->subsurface_list, parent_link) {
+        if (sub->surface != surface) {
+            releaseFrameCallbacks(sub->surface, time);
+        }
+    }
+}
+
+void Layer::releaseDetachedFrameCallbacks()
+{
+    uint32_t time = weston_compositor_get_time();
+    for (weston_layer *layer: m_detachedLayers) {
+        weston_view *view;
+        wl_list_for_each(view, &layer->view_list.link, layer_link.link) {
+            releaseFrameCallbacks(view->surface, time);
+        }
+    }
+}
+
 bool Layer::isVisible() const
 {
-    return !wl_list_empty(&m_layer.link) && !wl_list_empty(&m_layer.view_list.link);
+    bool detached = s_detaching && std::find(s_detaching->m_detachedLayers.begin(), s_detaching->m_detachedLayers.end(), &m_layer) != s_detaching->m_detachedLayers.end();
+    return (detached || !wl_list_empty(&m_layer.link)) && !wl_list_empty(&m_layer.view_list.link);
 }
 
 void Layer::show()
 {
+    reattachDetached();
     if (m_below) {
         wl_list_insert(m_below, &m_layer.link);
     }
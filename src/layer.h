@@ -18,6 +18,8 @@
 #ifndef LAYER_H
 #define LAYER_H
 
+#include <vector>
+
 #include <weston/compositor.h>
 
 #include "utils.h"
@@ -62,14 +64,33 @@ public:
     typedef Iterator<const struct wl_list, const weston_view> const_iterator;
 
     Layer();
-
-    void insert(struct weston_layer *below);
-    void insert(Layer *below);
-    void remove();
-    void hide();
+    ~Layer();
+
+    /*
+     * By default the views are damaged one by one when the layer is inserted
+     * or removed. Callers which can damage the whole area at once can pass
+     * false for damage.
+     */
+    void insert(struct weston_layer *below, bool damage = true);
+    void insert(Layer *below, bool damage = true);
+    void remove(bool damage = true);
+    void hide(bool damage = true);
     void show();
     bool isVisible() const;
 
+    /*
+     * Take all the layers below this one out of the compositor layer list,
+     * so that weston doesn't even look at them, and put them back.
+     * Weston doesn't repaint the detached layers, so
+     * releaseDetachedFrameCallbacks() must be called on every frame to keep
+     * their clients going. Inserting, showing or hiding any layer, this one
+     * included, reattaches them first, so that it is positioned correctly.
+     */
+    void detachBelow();
+    void reattachBelow();
+    inline bool isDetachedBelow() const { return !m_detachedLayers.empty(); }
+    void releaseDetachedFrameCallbacks();
+
     void addSurface(weston_view *surf);
     void addSurface(ShellSurface *surf);
     void restack(weston_view *surf);
@@ -88,6 +109,8 @@ public:
 private:
     struct weston_layer m_layer;
     struct wl_list *m_below;
+    // the layers taken out by detachBelow(), top first
+    std::vector<struct weston_layer *> m_detachedLayers;
 };
 
 template<class L, class S>
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2014  Giulio Camuffo <giuliocamuffo@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <weston/compositor.h>
+
+#include "occlusiontracker.h"
+#include "shell.h"
+#include "shellsurface.h"
+#include "framethrottle.h"
+
+OcclusionTracker::OcclusionTracker(weston_compositor *compositor)
+                : m_compositor(compositor)
+                , m_idleSource(nullptr)
+{
+    m_outputCreatedListener.listen(&compositor->output_created_signal);
+    m_outputCreatedListener.signal->connect(this, &OcclusionTracker::outputCreated);
+    m_outputDestroyedListener.listen(&compositor->output_destroyed_signal);
+    m_outputDestroyedListener.signal->connect(this, &OcclusionTracker::outputDestroyed);
+
+    weston_output *output;
+    wl_list_for_each(output, &compositor->output_list, link) {
+        outputCreated(output);
+    }
+}
+
+OcclusionTracker::~OcclusionTracker()
+{
+    if (m_idleSource) {
+        wl_event_source_remove(m_idleSource);
+    }
+    for (auto &i: m_frameListeners) {
+        delete i.second;
+    }
+}
+
+void OcclusionTracker::outputCreated(void *data)
+{
+    weston_output *output = static_cast<weston_output *>(data);
+    WlListener *listener = new WlListener;
+    listener->listen(&output->frame_signal);
+    listener->signal->connect(this, &OcclusionTracker::frame);
+    m_frameListeners[output] = listener;
+}
+
+void OcclusionTracker::outputDestroyed(void *data)
+{
+    auto it = m_frameListeners.find(static_cast<weston_output *>(data));
+    if (it != m_frameListeners.end()) {
+        delete it->second;
+        m_frameListeners.erase(it);
+    }
+}
+
+void OcclusionTracker::frame(void *data)
+{
+    // Many outputs may repaint in the same loop iteration, update once
+    if (m_idleSource) {
+        return;
+    }
+
+    wl_event_loop *loop = wl_display_get_event_loop(m_compositor->wl_display);
+    m_idleSource = wl_event_loop_add_idle(loop, [](void *data) {
+        OcclusionTracker *tracker = static_cast<OcclusionTracker *>(data);
+        tracker->m_idleSource = nullptr;
+        tracker->update();
+    }, this);
+}
+
+void OcclusionTracker::update()
+{
+    pixman_region32_t covered;
+    pixman_region32_init(&covered);
+
+    weston_view *view;
+    wl_list_for_each(view, &m_compositor->view_list, link) {
+        ShellSurface *shsurf = Shell::getShellSurface(view->surface);
+        if (shsurf && shsurf->view() == view) {
+            pixman_box32_t *box = pixman_region32_extents(&view->transform.boundingbox);
+            bool occluded = box->x1 < box->x2 && box->y1 < box->y2 &&
+                            pixman_region32_contains_rectangle(&covered, box) == PIXMAN_REGION_IN;
+            if (occluded) {
+                shsurf->frameThrottle()->throttle(this);
+            } else {
+                shsurf->frameThrottle()->unthrottle(this);
+            }
+        }
+
+        pixman_region32_union(&covered, &covered, &view->transform.opaque);
+    }
+
+    pixman_region32_fini(&covered);
+}
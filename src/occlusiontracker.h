@@ -0,0 +1,52 @@
+/*
+ * Copyright 2014  Giulio Camuffo <giuliocamuffo@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OCCLUSIONTRACKER_H
+#define OCCLUSIONTRACKER_H
+
+#include <unordered_map>
+
+#include "utils.h"
+
+/*
+ * After every repaint walks the compositor view list from top to bottom and
+ * throttles the frame callbacks of the shell surfaces completely covered by
+ * the opaque regions of the views above them. A surface gets its callbacks
+ * back in the repaint after any part of it becomes visible again.
+ * Views with an alpha or a non translation transform have no opaque region,
+ * so while the scale effect or the grid runs nothing is considered covered.
+ */
+class OcclusionTracker
+{
+public:
+    OcclusionTracker(weston_compositor *compositor);
+    ~OcclusionTracker();
+
+private:
+    void outputCreated(void *data);
+    void outputDestroyed(void *data);
+    void frame(void *data);
+    void update();
+
+    weston_compositor *m_compositor;
+    WlListener m_outputCreatedListener;
+    WlListener m_outputDestroyedListener;
+    std::unordered_map<weston_output *, WlListener *> m_frameListeners;
+    wl_event_source *m_idleSource;
+};
+
+#endif
@@ -0,0 +1,228 @@
+/*
+ * Copyright 2014  Giulio Camuffo <giuliocamuffo@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <string.h>
+
+#include "screencaststream.h"
+#include "wayland-screenshooter-server-protocol.h"
+
+ScreencastStream::ScreencastStream(wl_client *client, uint32_t id, weston_output *output, const IRect2D &rect)
+                : m_output(output)
+{
+    m_resource = wl_resource_create(client, &screenshooter_stream_interface, 1, id);
+    wl_resource_set_implementation(m_resource, &s_implementation, this, [](wl_resource *res) {
+        delete static_cast<ScreencastStream *>(wl_resource_get_user_data(res));
+    });
+
+    pixman_region32_init_rect(&m_rect, rect.x, rect.y, rect.width, rect.height);
+    pixman_region32_init(&m_damage);
+    pixman_region32_copy(&m_damage, &m_rect);
+
+    m_frameListener.listen(&output->frame_signal);
+    m_frameListener.signal->connect(this, &ScreencastStream::frame);
+    m_outputDestroyListener.listen(&output->destroy_signal);
+    m_outputDestroyListener.signal->connect(this, &ScreencastStream::outputDestroyed);
+
+    uint32_t format = output->compositor->read_format == PIXMAN_a8r8g8b8 ? WL_SHM_FORMAT_ARGB8888 : WL_SHM_FORMAT_ABGR8888;
+    screenshooter_stream_send_format(m_resource, format, rect.width, rect.height);
+}
+
+ScreencastStream::~ScreencastStream()
+{
+    for (Buffer *b: m_buffers) {
+        pixman_region32_fini(&b->damage);
+        delete b;
+    }
+    pixman_region32_fini(&m_rect);
+    pixman_region32_fini(&m_damage);
+}
+
+void ScreencastStream::frame(void *data)
+{
+    pixman_region32_t damage;
+    pixman_region32_init(&damage);
+    pixman_region32_intersect(&damage, &m_output->region, &m_output->previous_damage);
+    pixman_region32_translate(&damage, -m_output->x, -m_output->y);
+
+    // Go to framebuffer coordinates, as the captured rectangle is
+    pixman_region32_t transformed;
+    pixman_region32_init(&transformed);
+    weston_transformed_region(m_output->width, m_output->height, (wl_output_transform)m_output->transform,
+                              m_output->current_scale, &damage, &transformed);
+    pixman_region32_intersect(&transformed, &transformed, &m_rect);
+    pixman_region32_fini(&damage);
+
+    if (!pixman_region32_not_empty(&transformed) && !pixman_region32_not_empty(&m_damage)) {
+        pixman_region32_fini(&transformed);
+        return;
+    }
+
+    pixman_region32_union(&m_damage, &m_damage, &transformed);
+    Buffer *free = nullptr;
+    for (Buffer *b: m_buffers) {
+        pixman_region32_union(&b->damage, &b->damage, &transformed);
+        if (!free && !b->busy) {
+            free = b;
+        }
+    }
+    pixman_region32_fini(&transformed);
+
+    // Nothing to fill, the damage waits in the buffers for the next frame
+    if (!free) {
+        return;
+    }
+
+    fill(free);
+
+    const pixman_box32_t *extents = pixman_region32_extents(&m_rect);
+    wl_array rects;
+    wl_array_init(&rects);
+    int n;
+    pixman_box32_t *boxes = pixman_region32_rectangles(&m_damage, &n);
+    for (int i = 0; i < n; ++i) {
+        int32_t *r = static_cast<int32_t *>(wl_array_add(&rects, 4 * sizeof(int32_t)));
+        r[0] = boxes[i].x1 - extents->x1;
+        r[1] = boxes[i].y1 - extents->y1;
+        r[2] = boxes[i].x2 - boxes[i].x1;
+        r[3] = boxes[i].y2 - boxes[i].y1;
+    }
+    free->busy = true;
+    screenshooter_stream_send_frame(m_resource, free->resource, weston_compositor_get_time(), &rects);
+    wl_array_release(&rects);
+    pixman_region32_clear(&m_damage);
+}
+
+void ScreencastStream::fill(Buffer *buffer)
+{
+    weston_compositor *compositor = m_output->compositor;
+    const bool yflip = compositor->capabilities & WESTON_CAP_CAPTURE_YFLIP;
+    const pixman_box32_t *extents = pixman_region32_extents(&m_rect);
+    int stride = wl_shm_buffer_get_stride(buffer->shm);
+    // addBuffer() refuses these, never write past the rows anyway
+    if (stride < (extents->x2 - extents->x1) * 4) {
+        return;
+    }
+
+    wl_shm_buffer_begin_access(buffer->shm);
+    uint8_t *data = static_cast<uint8_t *>(wl_shm_buffer_get_data(buffer->shm));
+
+    int n;
+    pixman_box32_t *boxes = pixman_region32_rectangles(&buffer->damage, &n);
+    for (int i = 0; i < n; ++i) {
+        const pixman_box32_t &box = boxes[i];
+        int width = box.x2 - box.x1;
+        int height = box.y2 - box.y1;
+        m_pixels.resize(width * height * 4);
+
+        int y = yflip ? m_output->current_mode->height - box.y2 : box.y1;
+        compositor->renderer->read_pixels(m_output, compositor->read_format, m_pixels.data(), box.x1, y, width, height);
+
+        for (int row = 0; row < height; ++row) {
+            int src = yflip ? height - 1 - row : row;
+            memcpy(data + (box.y1 - extents->y1 + row) * stride + (box.x1 - extents->x1) * 4,
+                   m_pixels.data() + src * width * 4, width * 4);
+        }
+    }
+    wl_shm_buffer_end_access(buffer->shm);
+
+    pixman_region32_clear(&buffer->damage);
+}
+
+void ScreencastStream::outputDestroyed(void *data)
+{
+    m_frameListener.reset();
+    m_outputDestroyListener.reset();
+    m_output = nullptr;
+    screenshooter_stream_send_stopped(m_resource);
+}
+
+void ScreencastStream::bufferDestroyed(void *data)
+{
+    for (auto i = m_buffers.begin(); i != m_buffers.end(); ++i) {
+        if ((*i)->resource == data) {
+            pixman_region32_fini(&(*i)->damage);
+            delete *i;
+            m_buffers.erase(i);
+            break;
+        }
+    }
+}
+
+ScreencastStream::Buffer *ScreencastStream::findBuffer(wl_resource *resource)
+{
+    for (Buffer *b: m_buffers) {
+        if (b->resource == resource) {
+            return b;
+        }
+    }
+    return nullptr;
+}
+
+void ScreencastStream::destroy(wl_client *client, wl_resource *resource)
+{
+    wl_resource_destroy(resource);
+}
+
+void ScreencastStream::addBuffer(wl_client *client, wl_resource *resource, wl_resource *buffer_resource)
+{
+    if (!m_output || findBuffer(buffer_resource)) {
+        return;
+    }
+
+    const pixman_box32_t *extents = pixman_region32_extents(&m_rect);
+    uint32_t format = m_output->compositor->read_format == PIXMAN_a8r8g8b8 ? WL_SHM_FORMAT_ARGB8888 : WL_SHM_FORMAT_ABGR8888;
+    wl_shm_buffer *shm = wl_shm_buffer_get(buffer_resource);
+    if (!shm || wl_shm_buffer_get_format(shm) != format ||
+        wl_shm_buffer_get_width(shm) < extents->x2 - extents->x1 ||
+        wl_shm_buffer_get_height(shm) < extents->y2 - extents->y1 ||
+        wl_shm_buffer_get_stride(shm) < (extents->x2 - extents->x1) * 4) {
+        wl_resource_post_error(resource, SCREENSHOOTER_STREAM_ERROR_INVALID_BUFFER, "invalid buffer for the stream");
+        return;
+    }
+
+    Buffer *b = new Buffer;
+    b->resource = buffer_resource;
+    b->shm = shm;
+    b->busy = false;
+    // A new buffer has nothing in it yet
+    pixman_region32_init(&b->damage);
+    pixman_region32_copy(&b->damage, &m_rect);
+    b->destroyListener.listen(wl_resource_get_destroy_signal(buffer_resource));
+    b->destroyListener.signal->connect(this, &ScreencastStream::bufferDestroyed);
+    m_buffers.push_back(b);
+
+    weston_output_schedule_repaint(m_output);
+}
+
+void ScreencastStream::releaseBuffer(wl_client *client, wl_resource *resource, wl_resource *buffer_resource)
+{
+    if (Buffer *b = findBuffer(buffer_resource)) {
+        b->busy = false;
+        // frame() held back some damage for lack of a buffer, the screen may
+        // stay still now so don't wait for another repaint to deliver it
+        if (m_output && pixman_region32_not_empty(&m_damage)) {
+            weston_output_schedule_repaint(m_output);
+        }
+    }
+}
+
+const struct screenshooter_stream_interface ScreencastStream::s_implementation = {
+    wrapInterface(&ScreencastStream::destroy),
+    wrapInterface(&ScreencastStream::addBuffer),
+    wrapInterface(&ScreencastStream::releaseBuffer)
+};
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2014  Giulio Camuffo <giuliocamuffo@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef SCREENCASTSTREAM_H
+#define SCREENCASTSTREAM_H
+
+#include <list>
+#include <vector>
+
+#include <weston/compositor.h>
+
+#include "utils.h"
+
+/*
+ * Continuous capture of a rectangle of an output into a ring of client
+ * buffers. Every buffer keeps the damage accumulated since it was last
+ * filled, so only the changed parts are read back from the renderer.
+ * The object lives as long as its screenshooter_stream resource.
+ */
+class ScreencastStream
+{
+public:
+    ScreencastStream(wl_client *client, uint32_t id, weston_output *output, const IRect2D &rect);
+    ~ScreencastStream();
+
+private:
+    struct Buffer {
+        wl_resource *resource;
+        wl_shm_buffer *shm;
+        pixman_region32_t damage;
+        bool busy;
+        WlListener destroyListener;
+    };
+
+    void frame(void *data);
+    void outputDestroyed(void *data);
+    void bufferDestroyed(void *data);
+    void fill(Buffer *buffer);
+    Buffer *findBuffer(wl_resource *resource);
+
+    void destroy(wl_client *client, wl_resource *resource);
+    void addBuffer(wl_client *client, wl_resource *resource, wl_resource *buffer_resource);
+    void releaseBuffer(wl_client *client, wl_resource *resource, wl_resource *buffer_resource);
+
+    wl_resource *m_resource;
+    weston_output *m_output;
+    pixman_region32_t m_rect;
+    // what changed since the last frame event
+    pixman_region32_t m_damage;
+    std::list<Buffer *> m_buffers;
+    std::vector<uint8_t> m_pixels;
+    WlListener m_frameListener;
+    WlListener m_outputDestroyListener;
+
+    static const struct screenshooter_stream_interface s_implementation;
+};
+
+#endif
@@ -15,15 +15,23 @@
  * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
 #include <weston/compositor.h>
 
 #include "screenshooter.h"
 #include "shell.h"
+#include "screencaststream.h"
+#include "imageconvert.h"
+#include "executor.h"
 #include "wayland-screenshooter-server-protocol.h"
 
 Screenshooter::Screenshooter()
 {
-    wl_global_create(Shell::instance()->compositor()->wl_display, &screenshooter_interface, 1, this,
+    wl_global_create(Shell::instance()->compositor()->wl_display, &screenshooter_interface, 3, this,
                      [](wl_client *client, void *data, uint32_t version, uint32_t id) {
                          static_cast<Screenshooter *>(data)->bind(client, version, id);
                      });
@@ -71,6 +79,206 @@ void Screenshooter::shoot(wl_client *client, wl_resource *resource, wl_resource
     weston_screenshooter_shoot(output, buffer, done, resource);
 }
 
+void Screenshooter::startStream(wl_client *client, wl_resource *resource, uint32_t id, wl_resource *output_resource,
+                                int32_t x, int32_t y, int32_t width, int32_t height)
+{
+    weston_output *output = static_cast<weston_output *>(wl_resource_get_user_data(output_resource));
+    int w = output->current_mode->width;
+    int h = output->current_mode->height;
+
+    if (width <= 0 || height <= 0) {
+        x = y = 0;
+        width = w;
+        height = h;
+    }
+    // x + width may not fit in an int
+    int x1 = std::max(x, 0);
+    int y1 = std::max(y, 0);
+    int x2 = std::min<int64_t>((int64_t)x + width, w);
+    int y2 = std::min<int64_t>((int64_t)y + height, h);
+    if (x2 <= x1 || y2 <= y1) {
+        wl_resource_post_error(resource, SCREENSHOOTER_ERROR_INVALID_REGION, "the stream rectangle is not on the output");
+        return;
+    }
+
+    new ScreencastStream(client, id, output, IRect2D(x1, y1, x2 - x1, y2 - y1));
+}
+
+static bool formatLayout(uint32_t format, PixelLayout *layout)
+{
+    switch (format) {
+        case WL_SHM_FORMAT_ARGB8888:
+        case WL_SHM_FORMAT_XRGB8888:
+            *layout = PixelLayout::BGRA;
+            return true;
+        case WL_SHM_FORMAT_ABGR8888:
+        case WL_SHM_FORMAT_XBGR8888:
+            *layout = PixelLayout::RGBA;
+            return true;
+        case WL_SHM_FORMAT_RGB888:
+            *layout = PixelLayout::BGR;
+            return true;
+        case WL_SHM_FORMAT_BGR888:
+            *layout = PixelLayout::RGB;
+            return true;
+        default:
+            return false;
+    }
+}
+
+/*
+ * The readback happens on the compositor thread, on the first repaint of
+ * the output, and the conversion or encoding on a worker of the executor.
+ * The object lives until both the resource is gone and no work is pending.
+ */
+class ScreenshotCapture
+{
+public:
+    ScreenshotCapture(wl_client *client, uint32_t id, weston_output *output, wl_resource *buffer,
+                      uint32_t format, uint32_t flags)
+        : m_output(output)
+        , m_buffer(buffer)
+        , m_flags(flags)
+        , m_pending(false)
+    {
+        m_resource = wl_resource_create(client, &screenshooter_capture_interface, 1, id);
+        wl_resource_set_implementation(m_resource, &s_implementation, this, [](wl_resource *res) {
+            ScreenshotCapture *c = static_cast<ScreenshotCapture *>(wl_resource_get_user_data(res));
+            c->m_resource = nullptr;
+            if (!c->m_pending) {
+                delete c;
+            }
+        });
+
+        wl_shm_buffer *shm = wl_shm_buffer_get(buffer);
+        if (!shm) {
+            fail(SCREENSHOOTER_CAPTURE_FAILURE_INVALID_BUFFER);
+            return;
+        }
+        if (!(flags & SCREENSHOOTER_CAPTURE_FLAGS_ENCODE_QOI) && !formatLayout(format, &m_layout)) {
+            fail(SCREENSHOOTER_CAPTURE_FAILURE_UNSUPPORTED_FORMAT);
+            return;
+        }
+
+        m_frameListener.listen(&output->frame_signal);
+        m_frameListener.signal->connect(this, &ScreenshotCapture::frame);
+        m_outputDestroyListener.listen(&output->destroy_signal);
+        m_outputDestroyListener.signal->connect(this, &ScreenshotCapture::gone);
+        m_bufferDestroyListener.listen(wl_resource_get_destroy_signal(buffer));
+        m_bufferDestroyListener.signal->connect(this, &ScreenshotCapture::gone);
+        weston_output_damage(output);
+    }
+
+private:
+    void frame(void *)
+    {
+        m_frameListener.reset();
+        m_outputDestroyListener.reset();
+
+        weston_compositor *compositor = m_output->compositor;
+        m_width = m_output->current_mode->width;
+        m_height = m_output->current_mode->height;
+        m_pixels.resize(m_width * m_height * 4);
+        compositor->renderer->read_pixels(m_output, compositor->read_format, m_pixels.data(), 0, 0, m_width, m_height);
+
+        const PixelLayout src = compositor->read_format == PIXMAN_a8r8g8b8 ? PixelLayout::BGRA : PixelLayout::RGBA;
+        const bool flip = !(compositor->capabilities & WESTON_CAP_CAPTURE_YFLIP) != !(m_flags & SCREENSHOOTER_CAPTURE_FLAGS_Y_FLIP);
+        const int stride = wl_shm_buffer_get_stride(wl_shm_buffer_get(m_buffer));
+
+        m_pending = true;
+        Shell::executor()->run([this, src, flip, stride]() {
+            if (m_flags & SCREENSHOOTER_CAPTURE_FLAGS_ENCODE_QOI) {
+                encodeQoi(m_pixels.data(), m_width, m_height, m_width * 4, src, flip, &m_result);
+            } else if (stride >= m_width * bytesPerPixel(m_layout)) {
+                m_result.resize(stride * m_height);
+                convertImage(m_pixels.data(), m_width, m_height, m_width * 4, src,
+                             m_result.data(), stride, m_layout, flip);
+            }
+            std::vector<uint8_t>().swap(m_pixels);
+        }, [this]() { finished(); });
+    }
+
+    void finished()
+    {
+        m_pending = false;
+        if (!m_resource) {
+            delete this;
+            return;
+        }
+        if (!m_buffer) {
+            return;
+        }
+        m_bufferDestroyListener.reset();
+
+        wl_shm_buffer *shm = wl_shm_buffer_get(m_buffer);
+        const size_t capacity = wl_shm_buffer_get_stride(shm) * wl_shm_buffer_get_height(shm);
+        const bool encoded = m_flags & SCREENSHOOTER_CAPTURE_FLAGS_ENCODE_QOI;
+        if (m_result.empty() || m_result.size() > capacity ||
+            (!encoded && (wl_shm_buffer_get_width(shm) < m_width || wl_shm_buffer_get_height(shm) < m_height))) {
+            fail(SCREENSHOOTER_CAPTURE_FAILURE_BUFFER_TOO_SMALL);
+            return;
+        }
+
+        wl_shm_buffer_begin_access(shm);
+        memcpy(wl_shm_buffer_get_data(shm), m_result.data(), m_result.size());
+        wl_shm_buffer_end_access(shm);
+
+        screenshooter_capture_send_done(m_resource, m_width, m_height, m_result.size());
+        std::vector<uint8_t>().swap(m_result);
+    }
+
+    void gone(void *)
+    {
+        m_buffer = nullptr;
+        fail(SCREENSHOOTER_CAPTURE_FAILURE_GONE);
+    }
+
+    void fail(uint32_t reason)
+    {
+        m_frameListener.reset();
+        m_outputDestroyListener.reset();
+        m_bufferDestroyListener.reset();
+        if (m_resource) {
+            screenshooter_capture_send_failed(m_resource, reason);
+        }
+    }
+
+    void destroy(wl_client *client, wl_resource *resource)
+    {
+        wl_resource_destroy(resource);
+    }
+
+    wl_resource *m_resource;
+    weston_output *m_output;
+    wl_resource *m_buffer;
+    uint32_t m_flags;
+    PixelLayout m_layout;
+    bool m_pending;
+    int m_width;
+    int m_height;
+    // only touched by the worker while m_pending is true
+    std::vector<uint8_t> m_pixels;
+    std::vector<uint8_t> m_result;
+    WlListener m_frameListener;
+    WlListener m_outputDestroyListener;
+    WlListener m_bufferDestroyListener;
+
+    static const struct screenshooter_capture_interface s_implementation;
+};
+
+const struct screenshooter_capture_interface ScreenshotCapture::s_implementation = {
+    wrapInterface(&ScreenshotCapture::destroy)
+};
+
+void Screenshooter::capture(wl_client *client, wl_resource *resource, uint32_t id, wl_resource *output_resource,
+                            wl_resource *buffer_resource, uint32_t format, uint32_t flags)
+{
+    weston_output *output = static_cast<weston_output *>(wl_resource_get_user_data(output_resource));
+    new ScreenshotCapture(client, id, output, buffer_resource, format, flags);
+}
+
 const struct screenshooter_interface Screenshooter::s_implementation = {
-    wrapInterface(&Screenshooter::shoot)
+    wrapInterface(&Screenshooter::shoot),
+    wrapInterface(&Screenshooter::startStream),
+    wrapInterface(&Screenshooter::capture)
 };
@@ -30,6 +30,10 @@ public:
 private:
     void bind(wl_client *client, uint32_t version, uint32_t id);
     void shoot(wl_client *client, wl_resource *resource, wl_resource *output_resource, wl_resource *buffer_resource);
+    void startStream(wl_client *client, wl_resource *resource, uint32_t id, wl_resource *output_resource,
+                     int32_t x, int32_t y, int32_t width, int32_t height);
+    void capture(wl_client *client, wl_resource *resource, uint32_t id, wl_resource *output_resource,
+                 wl_resource *buffer_resource, uint32_t format, uint32_t flags);
 
     static const struct screenshooter_interface s_implementation;
 };
@@ -22,105 +22,428 @@
 #include <sstream>
 #include <iostream>
 #include <signal.h>
-#include <unordered_set>
+#include <fcntl.h>
+#include <algorithm>
 
 #include "sessionmanager.h"
+#include "shell.h"
+#include "executor.h"
+#include "shellsurface.h"
+#include "settings.h"
+#include "wl_shell/wlshellsurface.h"
+
+// The executable names to restore first, see SessionSettings below
+static std::string s_restoreOrder;
 
 SessionManager::SessionManager(const char *sessionFile)
               : m_sessionFile(sessionFile)
+              , m_appended(0)
+              , m_compacting(false)
+              , m_timeoutTimer(StartTimeout)
+              , m_restoreTime(0)
+              , m_restored(false)
 {
     printf("Using session file \"%s\".\n", sessionFile);
+    m_fd = open(sessionFile, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    m_timeoutTimer.triggered.connect(this, &SessionManager::timeout);
+    Shell::instance()->surfaceMappedSignal.connect(this, &SessionManager::surfaceMapped);
 }
 
-void SessionManager::restore()
+SessionManager::~SessionManager()
 {
-    FILE *session = fopen(m_sessionFile.c_str(), "r");
-    if (!session) {
+    // Keep the clients in the journal, they are the session to restore
+    for (auto &i: m_clients) {
+        delete i.second;
+    }
+    if (m_fd >= 0) {
+        fsync(m_fd);
+        close(m_fd);
+    }
+}
+
+void SessionManager::addClient(wl_client *client)
+{
+    if (m_clients.find(client) != m_clients.end()) {
         return;
     }
 
-    char buf[512];
+    Client *c = new Client;
+    wl_client_get_credentials(client, &c->pid, nullptr, nullptr);
+    c->destroyListener.signal->connect(this, &SessionManager::clientDestroyed);
+    wl_client_add_destroy_listener(client, c->destroyListener.listener());
+    m_clients[client] = c;
 
-    while (1) {
-        if (fgets(buf, sizeof(buf), session)) {
-            for (size_t i = 0; i < strlen(buf); ++i) {
-                if (buf[i] == '\n') {
-                    buf[i] = ' ';
-                }
-            }
-            start(buf);
+    pid_t pid = c->pid;
+    // A restored application keeps the command it had
+    auto l = m_launched.find(pid);
+    if (l != m_launched.end()) {
+        c->cmd = l->second.cmd;
+        if (!l->second.journaled) {
+            append(entry(std::to_string(pid), c->cmd));
+        }
+        m_launched.erase(l);
+        return;
+    }
+
+    Shell::executor()->compute<std::string>([pid]() { return commandLine(pid); }, [this, client, pid](std::string &cmd) {
+        auto i = m_clients.find(client);
+        if (i == m_clients.end() || i->second->pid != pid || cmd.empty()) {
+            return;
+        }
+        i->second->cmd = cmd;
+        append(entry(std::to_string(pid), cmd));
+    });
+}
+
+void SessionManager::clientDestroyed(void *data)
+{
+    auto i = m_clients.find(static_cast<wl_client *>(data));
+    if (i == m_clients.end()) {
+        return;
+    }
+
+    Client *c = i->second;
+    m_clients.erase(i);
+    if (!c->cmd.empty()) {
+        char buf[16];
+        sprintf(buf, "-%i", c->pid);
+        append(buf);
+    }
+    delete c;
+}
+
+std::string SessionManager::entry(const std::string &key, const std::string &cmd)
+{
+    return '+' + key + ' ' + cmd;
+}
+
+// The position of the executable of cmd in restore_order, past its end if absent
+int SessionManager::priority(const std::string &cmd)
+{
+    std::string exe = cmd.substr(0, cmd.find(' '));
+    size_t slash = exe.rfind('/');
+    if (slash != std::string::npos) {
+        exe = exe.substr(slash + 1);
+    }
+
+    int rank = 0;
+    size_t start = 0;
+    while ((start = s_restoreOrder.find_first_not_of(" ,", start)) != std::string::npos) {
+        size_t end = s_restoreOrder.find_first_of(" ,", start);
+        if (s_restoreOrder.compare(start, end == std::string::npos ? std::string::npos : end - start, exe) == 0) {
+            return rank;
+        }
+        ++rank;
+        start = end;
+    }
+    return rank;
+}
+
+void SessionManager::append(const std::string &line)
+{
+    if (m_fd < 0) {
+        return;
+    }
+
+    std::string data = line + '\n';
+    ssize_t ret = write(m_fd, data.c_str(), data.size());
+    (void)ret;
+    if (m_compacting) {
+        m_sinceCompaction.push_back(data);
+    } else if (++m_appended >= CompactThreshold) {
+        compact();
+    }
+}
+
+void SessionManager::compact()
+{
+    if (m_compacting) {
+        return;
+    }
+
+    std::string snapshot;
+    for (auto &i: m_clients) {
+        if (!i.second->cmd.empty()) {
+            snapshot += entry(std::to_string(i.second->pid), i.second->cmd) + '\n';
+        }
+    }
+    // The restore may not be over, keep what is still to come
+    for (auto &i: m_launched) {
+        if (i.second.journaled) {
+            snapshot += entry(std::to_string(i.first), i.second.cmd) + '\n';
+        }
+    }
+    for (const App &app: m_queued) {
+        snapshot += entry(app.key, app.cmd) + '\n';
+    }
+    m_compacting = true;
+    m_appended = 0;
+
+    std::string tmp = m_sessionFile + ".new";
+    Shell::executor()->compute<bool>([tmp, snapshot]() {
+        int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        bool ok = write(fd, snapshot.c_str(), snapshot.size()) == (ssize_t)snapshot.size() && fsync(fd) == 0;
+        close(fd);
+        return ok;
+    }, [this, tmp](bool &ok) {
+        m_compacting = false;
+        std::vector<std::string> lines;
+        lines.swap(m_sinceCompaction);
+        if (!ok) {
+            return;
+        }
+
+        // What was appended in the meantime goes in the new file too,
+        // then it can take the place of the old one
+        int fd = open(tmp.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        for (const std::string &line: lines) {
+            ssize_t ret = write(fd, line.c_str(), line.size());
+            (void)ret;
+        }
+        if (rename(tmp.c_str(), m_sessionFile.c_str()) == 0) {
+            close(m_fd);
+            m_fd = fd;
         } else {
-            break;
+            close(fd);
         }
+        m_appended = lines.size();
+    });
+}
+
+void SessionManager::restore()
+{
+    // The journal holds the running clients now, do not start them again
+    // when a new shell client gets ready
+    if (m_restored) {
+        return;
     }
+    m_restored = true;
 
-    fclose(session);
+    std::string file = m_sessionFile;
+    Shell::executor()->compute<std::vector<std::string>>([file]() { return readSession(file); },
+                                                         [this](std::vector<std::string> &commands) {
+        for (const std::string &line: commands) {
+            App app = { line, priority(line), 0, 0, 'r' + std::to_string(m_queued.size()) };
+            m_queued.push_back(app);
+        }
+        // std::list::sort is stable, so the file order is kept among equals
+        m_queued.sort([](const App &a, const App &b) { return a.priority < b.priority; });
+
+        // The previous session is in the queue now, start the journal over
+        compact();
+
+        m_restoreTime = LatencyHistogram::now();
+        startMore();
+    });
 }
 
-void SessionManager::save(const std::list<pid_t> &list)
+void SessionManager::startMore()
 {
-    FILE *session = fopen(m_sessionFile.c_str(), "w");
-    if (!session) {
+    while (!m_queued.empty() && m_starting.size() < MaxConcurrentStarts) {
+        App app = m_queued.front();
+        m_queued.pop_front();
+
+        app.startTime = LatencyHistogram::now();
+        app.pid = start(app.cmd.c_str());
+        // From now on the application is known by its pid
+        append('-' + app.key);
+        if (app.pid > 0) {
+            m_starting.push_back(app);
+            m_launched[app.pid] = { app.cmd, true };
+            append(entry(std::to_string(app.pid), app.cmd));
+        }
+    }
+
+    if (m_starting.empty()) {
+        m_timeoutTimer.stop();
+        if (m_restoreTime) {
+            printf("Session restored in %ums. Time to the first surface: %s\n",
+                   LatencyHistogram::now() - m_restoreTime, m_startupTimes.toString().c_str());
+            m_restoreTime = 0;
+        }
         return;
     }
 
-    std::unordered_set<pid_t> pids;
-    for (pid_t pid: list) {
-        if (pids.find(pid) == pids.end()) {
-            pids.insert(pid);
+    // Wake up when the oldest application runs out of time
+    uint32_t elapsed = LatencyHistogram::now() - m_starting.front().startTime;
+    m_timeoutTimer.stop();
+    m_timeoutTimer.setInterval(std::max(1, StartTimeout - (int)elapsed));
+    m_timeoutTimer.start();
+}
+
+void SessionManager::surfaceMapped(ShellSurface *shsurf)
+{
+    // Only wl_shell clients, the Xwayland ones are not started by themselves
+    if (shsurf->type() == ShellSurface::Type::TopLevel && shsurf->findInterface<WlShellSurface>()) {
+        addClient(shsurf->client());
+    }
+
+    if (m_starting.empty()) {
+        return;
+    }
+
+    pid_t pid;
+    wl_client_get_credentials(shsurf->client(), &pid, nullptr, nullptr);
+    for (auto i = m_starting.begin(); i != m_starting.end(); ++i) {
+        if (i->pid == pid) {
+            started(i, true);
+            startMore();
+            return;
         }
     }
+}
 
-    char file[32];
-    char buf[512];
-    char path[128];
+void SessionManager::timeout()
+{
+    m_timeoutTimer.stop();
 
-    for (pid_t pid: pids) {
-        sprintf(file, "/proc/%i/cmdline", pid);
-        FILE *f = fopen(file, "r");
-        size_t size = fread(buf, 1, sizeof(buf), f);
-        fclose(f);
-        for (size_t i = 0; i < size; ++i) {
-            if (buf[i] == '\0') {
-                buf[i] = ' ';
-            }
+    uint32_t now = LatencyHistogram::now();
+    for (auto i = m_starting.begin(); i != m_starting.end();) {
+        auto app = i++;
+        if (now - app->startTime >= (uint32_t)StartTimeout) {
+            started(app, false);
         }
-        buf[size - 1] = '\n';
-        buf[size] = '\0';
+    }
+    startMore();
+}
 
-        sprintf(file, "/proc/%i/exe", pid);
-        ssize_t ssize = readlink(file, path, sizeof(path));
-        if (ssize != -1) {
-            path[ssize] = '\0';
-            fputs(path, session);
-            fputs(" ", session);
+void SessionManager::started(std::list<App>::iterator app, bool mapped)
+{
+    uint32_t time = LatencyHistogram::now() - app->startTime;
+    auto l = m_launched.find(app->pid);
+    if (mapped) {
+        m_startupTimes.addSample(time);
+        printf("Session restore: \"%s\" mapped its first surface after %ums.\n", app->cmd.c_str(), time);
+        // Still there if what it mapped doesn't make it a session client
+        if (l != m_launched.end()) {
+            if (l->second.journaled) {
+                append('-' + std::to_string(app->pid));
+            }
+            m_launched.erase(l);
         }
+    } else {
+        printf("Session restore: \"%s\" did not map a surface in %ums, going on.\n", app->cmd.c_str(), time);
+        // It may never connect, don't keep it in the session meanwhile
+        if (l != m_launched.end() && l->second.journaled) {
+            l->second.journaled = false;
+            append('-' + std::to_string(app->pid));
+        }
+    }
+    m_starting.erase(app);
+}
 
-        fputs(buf, session);
+std::vector<std::string> SessionManager::readSession(const std::string &file)
+{
+    std::vector<std::string> commands;
+    FILE *session = fopen(file.c_str(), "r");
+    if (!session) {
+        return commands;
     }
 
+    // Replay the journal, keeping the order in which the clients came
+    std::vector<std::pair<std::string, std::string>> entries;
+    char buf[1024];
+    while (fgets(buf, sizeof(buf), session)) {
+        size_t len = strlen(buf);
+        if (len > 0 && buf[len - 1] == '\n') {
+            buf[--len] = '\0';
+        }
+
+        if (buf[0] == '+') {
+            char *cmd = strchr(buf, ' ');
+            if (cmd) {
+                entries.push_back(std::make_pair(std::string(buf + 1, cmd - buf - 1), std::string(cmd + 1)));
+            }
+        } else if (buf[0] == '-') {
+            std::string key(buf + 1);
+            for (auto i = entries.begin(); i != entries.end(); ++i) {
+                if (i->first == key) {
+                    entries.erase(i);
+                    break;
+                }
+            }
+        } else if (len > 0) {
+            entries.push_back(std::make_pair(std::string(), std::string(buf)));
+        }
+    }
     fclose(session);
+
+    for (auto &e: entries) {
+        commands.push_back(e.second);
+    }
+    return commands;
 }
 
-void SessionManager::start(const char *cmd)
+std::string SessionManager::commandLine(pid_t pid)
+{
+    char file[32];
+    char buf[512];
+    char path[128];
+
+    sprintf(file, "/proc/%i/cmdline", pid);
+    FILE *f = fopen(file, "r");
+    if (!f) {
+        return std::string();
+    }
+    size_t size = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    if (size == 0) {
+        return std::string();
+    }
+    for (size_t i = 0; i < size; ++i) {
+        if (buf[i] == '\0' || buf[i] == '\n') {
+            buf[i] = ' ';
+        }
+    }
+    buf[size - 1] = '\0';
+
+    std::string cmd;
+    sprintf(file, "/proc/%i/exe", pid);
+    ssize_t ssize = readlink(file, path, sizeof(path) - 1);
+    if (ssize != -1) {
+        path[ssize] = '\0';
+        cmd = std::string(path) + ' ';
+    }
+    return cmd + buf;
+}
+
+pid_t SessionManager::start(const char *cmd)
 {
     std::list<char *> strings;
     std::istringstream f(cmd);
     std::string s;
     while (std::getline(f, s, ' ')) {
-        strings.push_back(strdup(s.c_str()));
+        if (!s.empty()) {
+            strings.push_back(strdup(s.c_str()));
+        }
+    }
+    if (strings.empty()) {
+        return -1;
     }
 
     int argc = strings.size();
     const char *path = strings.front();
-    char *argv[argc + 1];
+    char *argv[argc];
     int i = 0;
     for (auto it = strings.begin(); it != strings.end(); ++it) {
         if (it != strings.begin()) {
             argv[i++] = *it;
         }
     }
-    argv[argc + 1] = nullptr;
+    argv[i] = nullptr;
+
+    // The intermediate process tells us the pid of the application, so that
+    // its surfaces can be recognized
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) < 0) {
+        fds[0] = fds[1] = -1;
+    }
 
     pid_t pid = fork();
     if (pid == 0) {
@@ -136,10 +459,50 @@ void SessionManager::start(const char *cmd)
             execv(path, argv);
             _exit(0);
         }
+        ssize_t ret = write(fds[1], &p2, sizeof(p2));
+        (void)ret;
         _exit(1);
     }
 
+    pid_t app = -1;
+    if (fds[1] >= 0) {
+        close(fds[1]);
+        if (pid < 0 || read(fds[0], &app, sizeof(app)) != sizeof(app)) {
+            app = -1;
+        }
+        close(fds[0]);
+    }
+
     for (char *str: strings) {
         free(str);
     }
+    return app;
 }
+
+
+class SessionSettings : public Settings
+{
+public:
+    virtual std::list<Option> options() const override
+    {
+        std::list<Option> list;
+        list.push_back(Option::string("restore_order"));
+        return list;
+    }
+
+    virtual void unSet(const std::string &name) override
+    {
+        if (name == "restore_order") {
+            s_restoreOrder.clear();
+        }
+    }
+
+    virtual void set(const std::string &name, const std::string &v) override
+    {
+        if (name == "restore_order") {
+            s_restoreOrder = v;
+        }
+    }
+};
+
+SETTINGS(session, SessionSettings)
@@ -20,19 +20,97 @@
 
 #include <string>
 #include <list>
+#include <vector>
+#include <unordered_map>
+#include <sys/types.h>
 
+#include "utils.h"
+#include "latencyhistogram.h"
+
+class ShellSurface;
+
+/*
+ * The session file is an append-only journal: "+<key> <command>" is added
+ * when a client maps its first toplevel wl_shell surface or binds the
+ * dropdown, and "-<key>" when it goes away. The key is the client pid, or
+ * "r<n>" for an application of the session being restored that was not started
+ * yet. It is compacted into the "+" lines of what is still alive every
+ * CompactThreshold appends. The command lines are read from /proc on the shell
+ * executor, and the compaction is written there too, so that they never stall
+ * the compositor thread. At shutdown the clients are not removed, so the
+ * journal then holds the session to restore.
+ * Lines without a '+' or '-' are commands too.
+ * On restore the applications are started in the order of their executable
+ * names in the restore_order option of the session settings, a list separated
+ * by spaces or commas, the other ones after them, and those with the same
+ * rank in file order, with at most MaxConcurrentStarts of them starting at a
+ * time. An application is done starting when it maps its first surface, or
+ * after StartTimeout ms. The ones still queued or starting stay in the
+ * journal, so a crash during the restore doesn't lose them.
+ */
 class SessionManager
 {
 public:
+    static const int MaxConcurrentStarts = 3;
+    static const int StartTimeout = 5000;
+    static const int CompactThreshold = 64;
+
     SessionManager(const char *sessionFile);
+    ~SessionManager();
 
     void restore();
-    void save(const std::list<pid_t> &pids);
+    void addClient(wl_client *client);
 
 private:
-    void start(const char *cmd);
+    struct App {
+        std::string cmd;
+        int priority;
+        pid_t pid;
+        uint32_t startTime;
+        // the journal key while it is queued
+        std::string key;
+    };
+
+    struct Client {
+        pid_t pid;
+        std::string cmd;
+        WlListener destroyListener;
+    };
+
+    // A restored application, until it connects
+    struct Launched {
+        std::string cmd;
+        // false once it took too long to start, it is journaled again if it connects
+        bool journaled;
+    };
+
+    void clientDestroyed(void *data);
+    static std::string entry(const std::string &key, const std::string &cmd);
+    static int priority(const std::string &cmd);
+    void append(const std::string &line);
+    void compact();
+    void startMore();
+    void surfaceMapped(ShellSurface *shsurf);
+    void timeout();
+    void started(std::list<App>::iterator app, bool mapped);
+    static std::vector<std::string> readSession(const std::string &file);
+    static std::string commandLine(pid_t pid);
+    static pid_t start(const char *cmd);
 
     std::string m_sessionFile;
+    int m_fd;
+    std::unordered_map<wl_client *, Client *> m_clients;
+    int m_appended;
+    bool m_compacting;
+    // the lines appended while a compaction is being written
+    std::vector<std::string> m_sinceCompaction;
+    std::list<App> m_queued;
+    std::list<App> m_starting;
+    std::unordered_map<pid_t, Launched> m_launched;
+    Timer m_timeoutTimer;
+    uint32_t m_restoreTime;
+    bool m_restored;
+    LatencyHistogram m_startupTimes;
 };
 
 #endif
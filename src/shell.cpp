@@ -16,6 +16,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include <sys/time.h>
 #include <linux/input.h>
 #include <signal.h>
@@ -32,6 +33,15 @@
 #include "animation.h"
 #include "interface.h"
 #include "settings.h"
+#include "occlusiontracker.h"
+#include "framethrottle.h"
+#include "executor.h"
+#include "geometrycache.h"
+
+// Delay before (re)launching the standby shell client, in ms
+static const int StandbyLaunchDelay = 3000;
+// Interval of the frame callbacks of hidden panels, in ms
+static const int PanelFrameInterval = 250;
 
 ShellGrab::ShellGrab()
          : m_pointer(nullptr)
@@ -208,7 +218,7 @@ void Shell::movePointer(weston_pointer *pointer, uint32_t time, weston_pointer_m
 {
     weston_pointer_move(pointer, event);
 
-    if (time - m_lastMotionTime < 1000) {
+    if (m_gameMode || time - m_lastMotionTime < 1000) {
         return;
     }
 
@@ -268,11 +278,21 @@ const weston_pointer_grab_interface Shell::s_defaultPointerGrabInterface = {
 
 Shell::Shell(struct weston_compositor *ec)
             : m_compositor(ec)
+            , m_executor(new Executor(wl_display_get_event_loop(ec->wl_display)))
+            , m_geometryCache(new GeometryCache)
             , m_windowsMinimized(false)
             , m_quitting(false)
+            , m_standbyEnabled(false)
+            , m_standbyTimer(StandbyLaunchDelay)
             , m_lastMotionTime(0)
             , m_enterHotZone(0)
             , m_grabView(nullptr)
+            , m_occlusionTracker(nullptr)
+            , m_fullscreenIdleSource(nullptr)
+            , m_detachedFrameOutput(nullptr)
+            , m_detachedFrameListener(nullptr)
+            , m_gameMode(false)
+            , m_panelsHidden(false)
 {
     s_instance = this;
 
@@ -281,17 +301,33 @@ Shell::Shell(struct weston_compositor *ec)
     m_child.desktop_shell = nullptr;
     m_child.client = nullptr;
     m_child.deathstamp = 0;
+    m_child.deathcount = 0;
+    m_standby.shell = this;
+    m_standby.desktop_shell = nullptr;
+    m_standby.client = nullptr;
+
+    m_standbyTimer.triggered.connect(this, &Shell::launchStandbyProcess);
 
     SettingsManager::init();
 }
 
 Shell::~Shell()
 {
+    if (m_fullscreenIdleSource) {
+        wl_event_source_remove(m_fullscreenIdleSource);
+    }
+    setDetachedFrameOutput(nullptr);
+    delete m_occlusionTracker;
+    delete m_executor;
+    delete m_geometryCache;
     SettingsManager::cleanup();
     free(m_clientPath);
     if (m_child.client) {
         kill(m_child.process.pid, SIGKILL);
     }
+    if (m_standby.client) {
+        kill(m_standby.process.pid, SIGKILL);
+    }
 }
 
 void Shell::destroy(void *)
@@ -305,7 +341,21 @@ void Shell::init()
 
     m_destroyListener.listen(&m_compositor->destroy_signal);
     m_destroyListener.signal->connect(this, &Shell::destroy);
+    m_outputCreatedListener.listen(&m_compositor->output_created_signal);
+    m_outputCreatedListener.signal->connect(this, &Shell::outputCreated);
+    m_outputDestroyedListener.listen(&m_compositor->output_destroyed_signal);
+    m_outputDestroyedListener.signal->connect(this, &Shell::outputDestroyed);
+    m_outputMovedListener.listen(&m_compositor->output_moved_signal);
+    m_outputMovedListener.signal->connect(this, &Shell::outputMoved);
+    m_seatCreatedListener.listen(&m_compositor->seat_created_signal);
+    m_seatCreatedListener.signal->connect(this, &Shell::seatCreated);
+
+    weston_seat *seat;
+    wl_list_for_each(seat, &m_compositor->seat_list, link) {
+        seatCreated(seat);
+    }
     m_grabViewDestroy.signal->connect(this, &Shell::grabViewDestroyed);
+    m_occlusionTracker = new OcclusionTracker(m_compositor);
 
     m_splashLayer.insert(&m_compositor->cursor_layer);
     m_overlayLayer.insert(&m_splashLayer);
@@ -362,6 +412,7 @@ void Shell::workspaceRemoved(Workspace *ws)
             break;
         }
     }
+    workspaceRemovedSignal(ws);
 
     int nextWs = ws->number();
     if (nextWs >= (int)m_workspaces.size()) {
@@ -409,6 +460,10 @@ void Shell::quit()
         wl_client_destroy(m_child.client);
         kill(m_child.process.pid, SIGTERM);
     }
+    if (m_standby.client) {
+        wl_client_destroy(m_standby.client);
+        kill(m_standby.process.pid, SIGTERM);
+    }
 }
 
 weston_view *Shell::defaultView(const weston_surface *surface)
@@ -433,10 +488,13 @@ weston_view *Shell::defaultView(const weston_surface *surface)
 
 void Shell::configureSurface(ShellSurface *surface, int32_t sx, int32_t sy)
 {
+    surface->frameThrottle()->commit();
+
     if (surface->width() == 0) {
         surface->unmapped();
         return;
     }
+    surface->committedSignal();
 
     if (surface->m_type == ShellSurface::Type::TopLevel && surface->m_state.fullscreen && !surface->m_nextState.fullscreen) {
         if (surface->m_fullscreen.type == ShellSurface::FullscreenMethod::Driver && surfaceIsTopFullscreen(surface)) {
@@ -444,6 +502,9 @@ void Shell::configureSurface(ShellSurface *surface, int32_t sx, int32_t sy)
         }
     }
     bool changedType = surface->updateType();
+    if (changedType || surface->m_state.fullscreen || surface->m_nextState.fullscreen) {
+        scheduleFullscreenUpdate();
+    }
 
     if (!surface->isMapped()) {
         switch (surface->m_type) {
@@ -505,6 +566,9 @@ void Shell::configureSurface(ShellSurface *surface, int32_t sx, int32_t sy)
                     surface->hide();
             }
         }
+
+        surfaceMappedSignal(surface);
+        surface->saveGeometry();
     } else if (changedType || sx != 0 || sy != 0 || surface->width() != surface->m_lastWidth || surface->height() != surface->m_lastHeight) {
         if (surface->resizeEdges() != ShellSurface::Edges::None) {
             sx = sy = 0;
@@ -530,6 +594,9 @@ void Shell::configureSurface(ShellSurface *surface, int32_t sx, int32_t sy)
         int y = surface->y() + to_y - from_y;
 
         weston_view_set_position(view, x, y);
+        // after the move, so that resizing from the left or top edge stores
+        // the new position
+        surface->saveGeometry();
 
         switch (surface->m_type) {
             case ShellSurface::Type::TopLevel:
@@ -647,6 +714,8 @@ void Shell::configureFullscreen(ShellSurface *shsurf)
     default:
         break;
     }
+
+    scheduleFullscreenUpdate();
 }
 
 void Shell::stackFullscreen(ShellSurface *shsurf)
@@ -661,6 +730,7 @@ void Shell::stackFullscreen(ShellSurface *shsurf)
 
     m_fullscreenLayer.stackBelow(shsurf->m_fullscreen.blackView, shsurf->view());
     weston_surface_damage(shsurf->m_fullscreen.blackView->surface);
+    scheduleFullscreenUpdate();
 }
 
 bool Shell::surfaceIsTopFullscreen(ShellSurface *surface)
@@ -678,6 +748,131 @@ bool Shell::isInFullscreen() const
     return m_fullscreenLayer.isVisible();
 }
 
+void Shell::scheduleFullscreenUpdate()
+{
+    if (m_fullscreenIdleSource) {
+        return;
+    }
+
+    wl_event_loop *loop = wl_display_get_event_loop(m_compositor->wl_display);
+    m_fullscreenIdleSource = wl_event_loop_add_idle(loop, [](void *data) {
+        Shell *shell = static_cast<Shell *>(data);
+        shell->m_fullscreenIdleSource = nullptr;
+        shell->updateFullscreenCulling();
+        shell->updateGameMode();
+    }, this);
+}
+
+void Shell::updateFullscreenCulling()
+{
+    bool cull = m_overlayLayer.isEmpty() && m_fullscreenLayer.isVisible();
+
+    if (cull) {
+        pixman_region32_t covered;
+        pixman_region32_init(&covered);
+        for (weston_view *view: m_fullscreenLayer) {
+            if (view->transform.dirty) {
+                weston_view_update_transform(view);
+            }
+            pixman_region32_union(&covered, &covered, &view->transform.opaque);
+        }
+
+        weston_output *output;
+        wl_list_for_each(output, &m_compositor->output_list, link) {
+            pixman_box32_t box = { output->x, output->y, output->x + output->width, output->y + output->height };
+            if (pixman_region32_contains_rectangle(&covered, &box) != PIXMAN_REGION_IN) {
+                cull = false;
+                break;
+            }
+        }
+        pixman_region32_fini(&covered);
+    }
+
+    if (cull) {
+        m_fullscreenLayer.detachBelow();
+    } else if (m_fullscreenLayer.isDetachedBelow()) {
+        m_fullscreenLayer.reattachBelow();
+        weston_compositor_damage_all(m_compositor);
+    }
+
+    // Pace the detached clients with the output of the top fullscreen
+    // surface, once per frame however many outputs there are
+    weston_output *output = nullptr;
+    if (m_fullscreenLayer.isDetachedBelow()) {
+        output = (*m_fullscreenLayer.begin())->output;
+        if (!output) {
+            output = getDefaultOutput();
+        }
+    }
+    setDetachedFrameOutput(output);
+}
+
+void Shell::setDetachedFrameOutput(weston_output *output)
+{
+    if (output == m_detachedFrameOutput) {
+        return;
+    }
+
+    delete m_detachedFrameListener;
+    m_detachedFrameListener = nullptr;
+    m_detachedFrameOutput = output;
+    if (output) {
+        m_detachedFrameListener = new WlListener;
+        m_detachedFrameListener->listen(&output->frame_signal);
+        m_detachedFrameListener->signal->connect(this, &Shell::detachedFrame);
+    }
+}
+
+void Shell::detachedFrame(void *data)
+{
+    // Weston doesn't repaint the detached surfaces, so it won't send their
+    // frame callbacks. Keep their clients going at the pace of the output.
+    if (!m_fullscreenLayer.isDetachedBelow()) {
+        scheduleFullscreenUpdate();
+        return;
+    }
+    m_fullscreenLayer.releaseDetachedFrameCallbacks();
+}
+
+void Shell::updateGameMode()
+{
+    bool gameMode = false;
+    if (isInFullscreen()) {
+        weston_seat *seat;
+        wl_list_for_each(seat, &m_compositor->seat_list, link) {
+            weston_surface *focus = seat->keyboard_state ? seat->keyboard_state->focus : nullptr;
+            ShellSurface *shsurf = focus ? getShellSurface(focus) : nullptr;
+            if (shsurf && shsurf->isFullscreen()) {
+                gameMode = true;
+                break;
+            }
+        }
+    }
+
+    if (gameMode == m_gameMode) {
+        return;
+    }
+
+    m_gameMode = gameMode;
+    m_enterHotZone = 0;
+    for (weston_view *view: m_panelsLayer) {
+        if (view->surface->configure == staticPanelConfigure) {
+            FrameThrottle *throttle = panelFrameThrottle(view->surface);
+            if (gameMode) {
+                throttle->throttle(&m_gameMode);
+            } else {
+                throttle->unthrottle(&m_gameMode);
+            }
+        }
+    }
+    gameModeChangedSignal(gameMode);
+}
+
+void Shell::keyboardFocusChanged(ShellSeat *seat, weston_keyboard *keyboard)
+{
+    scheduleFullscreenUpdate();
+}
+
 static void shell_surface_configure(struct weston_surface *surf, int32_t sx, int32_t sy)
 {
     ShellSurface *shsurf = Shell::getShellSurface(surf);
@@ -713,6 +908,7 @@ void Shell::removeShellSurface(ShellSurface *surface)
         e->removeSurface(surface);
     }
     m_surfaces.remove(surface);
+    scheduleFullscreenUpdate();
 }
 
 void Shell::registerEffect(Effect *effect)
@@ -799,6 +995,10 @@ void Shell::panelConfigure(weston_surface *es, int32_t sx, int32_t sy, PanelPosi
         m_panelsLayer.addSurface(view);
         weston_compositor_schedule_repaint(es->compositor);
     }
+
+    if (output) {
+        invalidateWindowsArea(output);
+    }
 }
 
 void Shell::setBackgroundSurface(struct weston_surface *surface, struct weston_output *output)
@@ -838,34 +1038,60 @@ void Shell::grabViewDestroyed(void *d)
 
 struct Panel {
     Panel(weston_surface *s, Shell::PanelPosition p, Shell *sh)
-        : surface(s), pos(p), shell(sh) {}
+        : surface(s), pos(p), shell(sh), throttle(s, PanelFrameInterval) {}
     weston_surface *surface;
     Shell::PanelPosition pos;
     Shell *shell;
+    FrameThrottle throttle;
     wl_listener destroyListener;
 };
 
 static void panelDestroyed(wl_listener *listener, void *data)
 {
     weston_surface *surface = static_cast<weston_surface *>(data);
-    delete static_cast<Panel *>(surface->configure_private);
+    Panel *panel = static_cast<Panel *>(surface->configure_private);
+    Shell *shell = panel->shell;
+    delete panel;
+
+    // The view is still in the panels layer, make windowsArea() skip it
+    surface->configure = nullptr;
+    surface->configure_private = nullptr;
+    if (surface->output) {
+        shell->invalidateWindowsArea(surface->output);
+    }
 }
 
 void Shell::staticPanelConfigure(weston_surface *es, int32_t sx, int32_t sy) {
     Panel *p = static_cast<Panel *>(es->configure_private);
+    p->throttle.commit();
     p->shell->panelConfigure(es, sx, sy, p->pos);
 }
 
+FrameThrottle *Shell::panelFrameThrottle(weston_surface *surface)
+{
+    return &static_cast<Panel *>(surface->configure_private)->throttle;
+}
+
 void Shell::addPanelSurface(weston_surface *surface, weston_output *output, PanelPosition pos)
 {
     if (surface->configure == staticPanelConfigure) {
         Panel *p = static_cast<Panel *>(surface->configure_private);
+        weston_output *old = surface->output;
         p->pos = pos;
         surface->output = output;
+        if (old && old != output) {
+            invalidateWindowsArea(old);
+        }
         return;
     }
 
     Panel *panel = new Panel(surface, pos, this);
+    if (m_gameMode) {
+        panel->throttle.throttle(&m_gameMode);
+    }
+    if (m_panelsHidden) {
+        panel->throttle.throttle(&m_panelsLayer);
+    }
     surface->configure = staticPanelConfigure;
     surface->configure_private = panel;
     surface->output = output;
@@ -878,7 +1104,9 @@ void Shell::addPanelSurface(weston_surface *surface, weston_output *output, Pane
 void Shell::addOverlaySurface(struct weston_surface *surface, struct weston_output *output)
 {
     surface->configure = [](struct weston_surface *es, int32_t sx, int32_t sy) {
-        configure_static_surface(es, &static_cast<Shell *>(es->configure_private)->m_overlayLayer); };
+        Shell *shell = static_cast<Shell *>(es->configure_private);
+        configure_static_surface(es, &shell->m_overlayLayer);
+        shell->scheduleFullscreenUpdate(); };
     surface->configure_private = this;
     surface->output = output;
     weston_view *view = weston_view_create(surface);
@@ -887,22 +1115,93 @@ void Shell::addOverlaySurface(struct weston_surface *surface, struct weston_outp
 
 void Shell::showPanels()
 {
+    if (!m_panelsHidden) {
+        return;
+    }
+
+    m_panelsHidden = false;
+    m_panelsLayer.show();
     for (weston_view *v: m_panelsLayer) {
-        v->alpha = 1;
+        if (v->surface->configure == staticPanelConfigure) {
+            panelFrameThrottle(v->surface)->unthrottle(&m_panelsLayer);
+        }
     }
 }
 
 void Shell::hidePanels()
 {
-    // Use this total transparency instead of removing the layer
-    // because we want to the surface to keep receiving fram callbacks,
-    // otherwise Qt's main thread will be stuck.
+    if (m_panelsHidden) {
+        return;
+    }
+
+    // The panels must keep receiving frame callbacks even if they are not
+    // rendered, otherwise Qt's main thread will be stuck. Send them at a
+    // low rate instead of on every repaint.
+    m_panelsHidden = true;
     for (weston_view *v: m_panelsLayer) {
-        v->alpha = 0;
+        if (v->surface->configure == staticPanelConfigure) {
+            panelFrameThrottle(v->surface)->throttle(&m_panelsLayer);
+        }
     }
+    m_panelsLayer.hide();
 }
 
 IRect2D Shell::windowsArea(struct weston_output *output) const
+{
+    auto it = m_windowsAreas.find(output);
+    if (it != m_windowsAreas.end()) {
+        return it->second;
+    }
+
+    IRect2D rect = computeWindowsArea(output);
+    m_windowsAreas.insert({ output, rect });
+    return rect;
+}
+
+void Shell::invalidateWindowsArea(struct weston_output *output)
+{
+    IRect2D rect = computeWindowsArea(output);
+    auto it = m_windowsAreas.find(output);
+    if (it != m_windowsAreas.end()) {
+        if (it->second == rect) {
+            return;
+        }
+        it->second = rect;
+    } else {
+        m_windowsAreas.insert({ output, rect });
+    }
+    windowsAreaChangedSignal(output);
+}
+
+void Shell::outputCreated(void *data)
+{
+    invalidateWindowsArea(static_cast<weston_output *>(data));
+    scheduleFullscreenUpdate();
+}
+
+void Shell::outputDestroyed(void *data)
+{
+    weston_output *output = static_cast<weston_output *>(data);
+    if (output == m_detachedFrameOutput) {
+        setDetachedFrameOutput(nullptr);
+    }
+    m_windowsAreas.erase(output);
+    scheduleFullscreenUpdate();
+}
+
+void Shell::seatCreated(void *data)
+{
+    weston_seat *seat = static_cast<weston_seat *>(data);
+    ShellSeat::shellSeat(seat)->keyboardFocusSignal.connect(this, &Shell::keyboardFocusChanged);
+}
+
+void Shell::outputMoved(void *data)
+{
+    invalidateWindowsArea(static_cast<weston_output *>(data));
+    scheduleFullscreenUpdate();
+}
+
+IRect2D Shell::computeWindowsArea(struct weston_output *output) const
 {
     pixman_region32_t area;
     pixman_region32_init_rect(&area, output->x, output->y, output->width, output->height);
@@ -987,6 +1286,10 @@ void Shell::activateWorkspace(Workspace *old)
 
     currentWorkspace()->setActive(true);
     currentWorkspace()->insert(&m_limboLayer);
+    currentWorkspaceChangedSignal();
+    if (old && old != currentWorkspace()) {
+        workspaceSwitchedSignal(old, currentWorkspace());
+    }
 
     for (const weston_view *view: currentWorkspace()->layer()) {
         ShellSurface *shsurf = getShellSurface(view->surface);
@@ -1024,11 +1327,15 @@ void Shell::showAllWorkspaces()
     }
 }
 
-void Shell::resetWorkspaces()
+void Shell::resetWorkspaces(int32_t id)
 {
     for (Workspace *w: m_workspaces) {
         w->remove();
     }
+    if (id >= 0 && id < (int32_t)m_workspaces.size() && id != (int32_t)m_currentWorkspace) {
+        currentWorkspace()->setActive(false);
+        m_currentWorkspace = id;
+    }
     activateWorkspace(nullptr);
 }
 
@@ -1100,6 +1407,11 @@ void Shell::addStickyView(weston_view *v)
 
 bool Shell::isTrusted(wl_client *client, const char *interface) const
 {
+    // The standby instance may only bind desktop_shell, which stays inert
+    // until it is promoted
+    if (client && client == m_standby.client) {
+        return strcmp(interface, "desktop_shell") == 0;
+    }
     return client == m_child.client;
 }
 
@@ -1115,12 +1427,13 @@ weston_output *Shell::outputAt(int x, int y) const
     return nullptr;
 }
 
-void Shell::sigchld(int status)
+void Shell::sigchld(Child *child, int status)
 {
     uint32_t time;
 
-    m_child.process.pid = 0;
-    m_child.client = nullptr; /* already destroyed by wayland */
+    child->process.pid = 0;
+    child->client = nullptr; /* already destroyed by wayland */
+    child->desktop_shell = nullptr;
 
     if (m_quitting) {
         return;
@@ -1136,23 +1449,88 @@ void Shell::sigchld(int status)
     m_child.deathcount++;
     if (m_child.deathcount > 5) {
         weston_log("weston-desktop-shell died, giving up.\n");
+        m_standbyTimer.stop();
         return;
     }
 
-    weston_log("weston-desktop-shell died, respawning...\n");
-    launchShellProcess();
+    if (child == &m_standby) {
+        weston_log("standby weston-desktop-shell died, respawning...\n");
+        m_standbyTimer.start();
+        return;
+    }
+
+    if (promoteStandby()) {
+        weston_log("weston-desktop-shell died, switching to the standby instance...\n");
+        shellClientPromoted();
+    } else {
+        weston_log("weston-desktop-shell died, respawning...\n");
+        launchShellProcess();
+    }
+}
+
+bool Shell::launchChild(Child *child)
+{
+    child->client = weston_client_launch(m_compositor,
+                                         &child->process,
+                                         m_clientPath,
+                                         [](struct weston_process *process, int status) {
+                                             Child *child = container_of(process, Child, process);
+                                             child->shell->sigchld(child, status);
+                                         });
+
+    if (!child->client) {
+        weston_log("not able to start %s\n", m_clientPath);
+        return false;
+    }
+    return true;
 }
 
 void Shell::launchShellProcess()
 {
-    m_child.client = weston_client_launch(m_compositor,
-                                          &m_child.process,
-                                          m_clientPath,
-                                          [](struct weston_process *process, int status) {
-                                              Child *child = container_of(process, Child, process);
-                                              child->shell->sigchld(status);
-                                          });
+    launchChild(&m_child);
 
-    if (!m_child.client)
-        weston_log("not able to start %s\n", m_clientPath);
+    if (m_standbyEnabled && !m_standby.client) {
+        // Don't slow down the startup of the active instance
+        m_standbyTimer.start();
+    }
+}
+
+void Shell::setStandbyEnabled(bool enabled)
+{
+    m_standbyEnabled = enabled;
+}
+
+void Shell::launchStandbyProcess()
+{
+    m_standbyTimer.stop();
+    if (!m_standbyEnabled || m_standby.client || m_quitting) {
+        return;
+    }
+
+    launchChild(&m_standby);
+}
+
+bool Shell::promoteStandby()
+{
+    // Only take over with an instance which is connected and bound
+    if (!m_standby.client || !m_standby.desktop_shell) {
+        return false;
+    }
+
+    m_child.client = m_standby.client;
+    m_child.desktop_shell = m_standby.desktop_shell;
+    m_child.process.pid = m_standby.process.pid;
+    m_child.process.cleanup = m_standby.process.cleanup;
+    /* weston has no call to stop watching a process, take m_standby out of
+     * its list by hand and watch m_child instead. */
+    wl_list_remove(&m_standby.process.link);
+    wl_list_init(&m_standby.process.link);
+    weston_watch_process(&m_child.process);
+
+    m_standby.client = nullptr;
+    m_standby.desktop_shell = nullptr;
+    m_standby.process.pid = 0;
+
+    m_standbyTimer.start();
+    return true;
 }
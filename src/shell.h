@@ -34,6 +34,10 @@ class Effect;
 class Workspace;
 class ShellSeat;
 class Animation;
+class OcclusionTracker;
+class FrameThrottle;
+class Executor;
+class GeometryCache;
 
 typedef std::list<ShellSurface *> ShellSurfaceList;
 
@@ -105,6 +109,7 @@ public:
     void quit();
 
     void launchShellProcess();
+    void setStandbyEnabled(bool enabled);
     virtual ShellSurface *createShellSurface(weston_surface *surface, const weston_shell_client *client);
     void removeShellSurface(ShellSurface *surface);
     static ShellSurface *getShellSurface(const struct weston_surface *surf);
@@ -123,7 +128,22 @@ public:
     void hidePanels();
     bool isInFullscreen() const;
 
+    /*
+     * When the fullscreen layer covers all the outputs with opaque views, the
+     * layers below it are detached from the compositor, and when a fullscreen
+     * surface has the keyboard focus the shell enters the game mode. Call this
+     * when something that may change that happens; the check runs on idle.
+     */
+    void scheduleFullscreenUpdate();
+    /*
+     * In game mode the shell defers or skips all the work not needed by the
+     * fullscreen client: hot spots, pings, the panels frame callbacks, ...
+     */
+    inline bool isInGameMode() const { return m_gameMode; }
+
     virtual IRect2D windowsArea(struct weston_output *output) const;
+    /* Recompute the cached windows area, emitting windowsAreaChangedSignal if it changed. */
+    void invalidateWindowsArea(struct weston_output *output);
 
     struct weston_output *getDefaultOutput() const;
     Workspace *currentWorkspace() const;
@@ -134,7 +154,17 @@ public:
     uint32_t numWorkspaces() const;
 
     void showAllWorkspaces();
-    void resetWorkspaces();
+    /* Show only the current workspace again, or the one given by id. */
+    void resetWorkspaces(int32_t id = -1);
+
+    Signal<> currentWorkspaceChangedSignal;
+    // emitted when going from one workspace to another, but not by resetWorkspaces()
+    Signal<Workspace *, Workspace *> workspaceSwitchedSignal;
+    Signal<weston_output *> windowsAreaChangedSignal;
+    Signal<bool> gameModeChangedSignal;
+    // emitted when a surface is mapped for the first time
+    Signal<ShellSurface *> surfaceMappedSignal;
+    Signal<Workspace *> workspaceRemovedSignal;
 
     void minimizeWindows();
     void restoreWindows();
@@ -144,6 +174,8 @@ public:
 
     static Shell *instance() { return s_instance; }
     inline static weston_compositor *compositor() { return instance()->m_compositor; }
+    inline static Executor *executor() { return instance()->m_executor; }
+    inline GeometryCache *geometryCache() const { return m_geometryCache; }
 
     void bindHotSpot(Binding::HotSpot hs, Binding *b);
     void removeHotSpotBinding(Binding *b);
@@ -171,6 +203,8 @@ protected:
     virtual void defaultPointerGrabAxisSource(weston_pointer_grab *grab, uint32_t source);
     virtual void defaultPointerGrabFrame(weston_pointer_grab *grab);
     virtual void movePointer(weston_pointer *pointer, uint32_t time, weston_pointer_motion_event *event);
+    /* Called when the standby client replaces the dead shell client. */
+    virtual void shellClientPromoted() {}
 
     struct Child {
         Shell *shell;
@@ -182,6 +216,11 @@ protected:
         uint32_t deathstamp;
     };
     Child m_child;
+    /*
+     * A second instance of the shell client, launched in advance and kept
+     * dormant so that it can take over as soon as m_child dies.
+     */
+    Child m_standby;
 
     Layer m_backgroundLayer;
     Layer m_panelsLayer;
@@ -191,7 +230,10 @@ protected:
 
 private:
     void destroy(void *);
-    void sigchld(int status);
+    void sigchld(Child *child, int status);
+    bool launchChild(Child *child);
+    void launchStandbyProcess();
+    bool promoteStandby();
     void backgroundConfigure(struct weston_surface *es, int32_t sx, int32_t sy);
     void activateSurface(struct weston_seat *seat, uint32_t time, uint32_t button);
     void configureFullscreen(ShellSurface *surface);
@@ -202,9 +244,26 @@ private:
     weston_view *createBlackSurface(int x, int y, int w, int h);
     void workspaceRemoved(Workspace *ws);
     void grabViewDestroyed(void *d);
+    IRect2D computeWindowsArea(struct weston_output *output) const;
+    void outputCreated(void *data);
+    void outputDestroyed(void *data);
+    void outputMoved(void *data);
+    void seatCreated(void *data);
+    void updateFullscreenCulling();
+    void setDetachedFrameOutput(weston_output *output);
+    void detachedFrame(void *data);
+    void updateGameMode();
+    void keyboardFocusChanged(ShellSeat *seat, weston_keyboard *keyboard);
 
     struct weston_compositor *m_compositor;
+    Executor *m_executor;
+    GeometryCache *m_geometryCache;
     WlListener m_destroyListener;
+    WlListener m_outputCreatedListener;
+    WlListener m_outputDestroyedListener;
+    WlListener m_outputMovedListener;
+    WlListener m_seatCreatedListener;
+    mutable std::unordered_map<weston_output *, IRect2D> m_windowsAreas;
     char *m_clientPath;
     Layer m_splashLayer;
     Layer m_limboLayer;
@@ -214,6 +273,8 @@ private:
     uint32_t m_currentWorkspace;
     bool m_windowsMinimized;
     bool m_quitting;
+    bool m_standbyEnabled;
+    Timer m_standbyTimer;
     std::unordered_map<weston_output *, weston_surface *> m_backgrounds;
 
     std::unordered_map<int, std::list<Binding *>> m_hotSpotBindings;
@@ -223,8 +284,15 @@ private:
     std::list<weston_view *> m_blackSurfaces;
     weston_view *m_grabView;
     WlListener m_grabViewDestroy;
+    OcclusionTracker *m_occlusionTracker;
+    wl_event_source *m_fullscreenIdleSource;
+    weston_output *m_detachedFrameOutput;
+    WlListener *m_detachedFrameListener;
+    bool m_gameMode;
+    bool m_panelsHidden;
 
     static void staticPanelConfigure(weston_surface *es, int32_t sx, int32_t sy);
+    static FrameThrottle *panelFrameThrottle(weston_surface *surface);
 
     static const weston_pointer_grab_interface s_defaultPointerGrabInterface;
     static Shell *s_instance;
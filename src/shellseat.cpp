@@ -73,20 +73,27 @@ ShellSeat::ShellSeat(struct weston_seat *seat)
     m_listeners.seatDestroy.notify = seatDestroyed;
     wl_signal_add(&seat->destroy_signal, &m_listeners.seatDestroy);
 
-    if (seat->pointer_state) {
-        m_listeners.pointerFocus.notify = pointerFocus;
-        wl_signal_add(&seat->pointer_state->focus_signal, &m_listeners.pointerFocus);
-        m_listeners.pointerMotion.notify = pointerMotion;
-        wl_signal_add(&seat->pointer_state->motion_signal, &m_listeners.pointerMotion);
-    } else {
-        wl_list_init(&m_listeners.pointerFocus.link);
-        wl_list_init(&m_listeners.pointerMotion.link);
+    m_listeners.pointerFocus.notify = pointerFocus;
+    wl_list_init(&m_listeners.pointerFocus.link);
+    m_listeners.pointerMotion.notify = pointerMotion;
+    wl_list_init(&m_listeners.pointerMotion.link);
+    m_listeners.keyboardFocus.notify = keyboardFocus;
+    wl_list_init(&m_listeners.keyboardFocus.link);
+    listenToDevices();
+
+    // A new seat gets its pointer and keyboard only after it is announced
+    m_listeners.capsUpdated.notify = capsUpdated;
+    wl_signal_add(&seat->updated_caps_signal, &m_listeners.capsUpdated);
+}
+
+void ShellSeat::listenToDevices()
+{
+    if (m_seat->pointer_state && wl_list_empty(&m_listeners.pointerFocus.link)) {
+        wl_signal_add(&m_seat->pointer_state->focus_signal, &m_listeners.pointerFocus);
+        wl_signal_add(&m_seat->pointer_state->motion_signal, &m_listeners.pointerMotion);
     }
-    if (seat->keyboard_state) {
-        m_listeners.keyboardFocus.notify = keyboardFocus;
-        wl_signal_add(&seat->keyboard_state->focus_signal, &m_listeners.keyboardFocus);
-    } else {
-        wl_list_init(&m_listeners.keyboardFocus.link);
+    if (m_seat->keyboard_state && wl_list_empty(&m_listeners.keyboardFocus.link)) {
+        wl_signal_add(&m_seat->keyboard_state->focus_signal, &m_listeners.keyboardFocus);
     }
 }
 
@@ -99,6 +106,7 @@ ShellSeat::~ShellSeat()
     wl_list_remove(&m_listeners.pointerFocus.link);
     wl_list_remove(&m_listeners.pointerMotion.link);
     wl_list_remove(&m_listeners.keyboardFocus.link);
+    wl_list_remove(&m_listeners.capsUpdated.link);
 }
 
 ShellSeat *ShellSeat::shellSeat(struct weston_seat *seat)
@@ -160,6 +168,12 @@ void ShellSeat::pointerMotion(wl_listener *listener, void *data)
     shseat->pointerMotionSignal(shseat, pointer);
 }
 
+void ShellSeat::capsUpdated(wl_listener *listener, void *data)
+{
+    ShellSeat *shseat = static_cast<Wrapper *>(container_of(listener, Wrapper, capsUpdated))->seat;
+    shseat->listenToDevices();
+}
+
 void ShellSeat::keyboardFocus(wl_listener *listener, void *data)
 {
     ShellSeat *shseat = static_cast<Wrapper *>(container_of(listener, Wrapper, keyboardFocus))->seat;
@@ -54,6 +54,8 @@ private:
     static void pointerFocus(struct wl_listener *listener, void *data);
     static void pointerMotion(wl_listener *listener, void *data);
     static void keyboardFocus(wl_listener *listener, void *data);
+    static void capsUpdated(wl_listener *listener, void *data);
+    void listenToDevices();
 
     struct weston_seat *m_seat;
     FocusState *m_focusState;
@@ -64,6 +66,7 @@ private:
         struct wl_listener pointerFocus;
         wl_listener pointerMotion;
         wl_listener keyboardFocus;
+        wl_listener capsUpdated;
     } m_listeners;
 
     struct PopupGrab {
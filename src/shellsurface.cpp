@@ -20,20 +20,26 @@
 #include <signal.h>
 #include <unistd.h>
 
+#include <algorithm>
+
 #include <weston/compositor.h>
 
 #include "shellsurface.h"
 #include "shell.h"
 #include "shellseat.h"
 #include "workspace.h"
+#include "geometrycache.h"
 
 ShellSurface::ShellSurface(Shell *shell, struct weston_surface *surface)
             : m_shell(shell)
             , m_workspace(nullptr)
             , m_surface(surface)
             , m_view(weston_view_create(surface))
+            , m_frameThrottle(surface)
             , m_type(Type::None)
             , m_savedPos(false)
+            , m_hasCachedPos(false)
+            , m_geometryApplied(false)
             , m_acceptState(true)
             , m_runningGrab(nullptr)
             , m_active(false)
@@ -54,6 +60,7 @@ ShellSurface::ShellSurface(Shell *shell, struct weston_surface *surface)
 
 ShellSurface::~ShellSurface()
 {
+    saveGeometry();
     if (m_runningGrab) {
         delete m_runningGrab;
     }
@@ -162,6 +169,7 @@ void ShellSurface::show()
 void ShellSurface::hide()
 {
     weston_layer_entry_remove(&m_view->layer_link);
+    m_shell->scheduleFullscreenUpdate();
 }
 
 bool ShellSurface::updateType()
@@ -223,9 +231,13 @@ void ShellSurface::map(int32_t x, int32_t y)
         case Type::None:
             if (m_savedPos) {
                 restorePos();
+            } else if (m_hasCachedPos && m_shell->outputAt(m_cachedX + width() / 2, m_cachedY + height() / 2)) {
+                weston_view_set_position(m_view, m_cachedX, m_cachedY);
             } else {
+                // The output the cached position was on may be gone
                 weston_view_set_position(m_view, x, y);
             }
+            m_hasCachedPos = false;
         default:
             break;
     }
@@ -247,6 +259,7 @@ void ShellSurface::unmapped()
         m_popup.seat = nullptr;
     }
     savePos();
+    m_shell->scheduleFullscreenUpdate();
     unmappedSignal();
 }
 
@@ -268,9 +281,63 @@ void ShellSurface::restorePos()
     }
 }
 
+/*
+ * Configure a new toplevel like the last window of the same application, as
+ * soon as its class is known, so that it hopefully renders its first buffer
+ * at the right size already. The position is applied by map().
+ */
+void ShellSurface::applyCachedGeometry()
+{
+    if (m_geometryApplied || m_class.empty() || m_type != Type::TopLevel || m_nextState.transient ||
+        m_nextState.fullscreen || isMapped()) {
+        return;
+    }
+    m_geometryApplied = true;
+
+    GeometryCache::Geometry g;
+    if (!m_shell->geometryCache()->lookup(m_class, &g)) {
+        return;
+    }
+
+    if (g.workspace >= 0 && g.workspace < (int)m_shell->numWorkspaces()) {
+        m_workspace = m_shell->workspace(g.workspace);
+    }
+    if (g.maximized) {
+        if (!m_nextState.maximized) {
+            weston_output *output = m_shell->outputAt(g.x + g.width / 2, g.y + g.height / 2);
+            setMaximized(output ? output : m_shell->getDefaultOutput());
+        }
+        return;
+    }
+
+    m_cachedX = g.x;
+    m_cachedY = g.y;
+    m_hasCachedPos = true;
+    if (!m_nextState.maximized) {
+        m_client->send_configure(m_surface, g.width, g.height);
+    }
+}
+
+void ShellSurface::saveGeometry()
+{
+    if (m_type != Type::TopLevel || m_class.empty() || m_state.transient || m_state.fullscreen || width() <= 0) {
+        return;
+    }
+
+    GeometryCache::Geometry g;
+    if (m_state.maximized && m_savedSize) {
+        g = { m_savedX, m_savedY, m_savedWidth, m_savedHeight, true, 0 };
+    } else {
+        g = { x(), y(), width(), height(), m_state.maximized, 0 };
+    }
+    g.workspace = m_workspace ? m_workspace->number() : -1;
+    m_shell->geometryCache()->store(m_class, g);
+}
+
 void ShellSurface::setTopLevel()
 {
     m_type = Type::TopLevel;
+    applyCachedGeometry();
 }
 
 void ShellSurface::setTransient(struct weston_surface *parent, int x, int y, bool inactive)
@@ -297,13 +364,19 @@ void ShellSurface::setXWayland(int x, int y, bool inactive)
 
 void ShellSurface::setTitle(const char *title)
 {
+    if (m_title == title) {
+        return;
+    }
+
     m_title = title;
     titleChangedSignal();
+    applyCachedGeometry();
 }
 
 void ShellSurface::setClass(const char *c)
 {
     m_class = c;
+    applyCachedGeometry();
 }
 
 void ShellSurface::setMargins(int32_t left, int32_t right, int32_t top, int32_t bottom)
@@ -417,6 +490,12 @@ int32_t ShellSurface::transformedHeight() const
     return box->y2 - box->y1;
 }
 
+IRect2D ShellSurface::transformedRect() const
+{
+    const pixman_box32_t *box = pixman_region32_extents(&m_view->transform.boundingbox);
+    return IRect2D(box->x1, box->y1, box->x2 - box->x1, box->y2 - box->y1);
+}
+
 void ShellSurface::setPosition(float x, float y)
 {
     weston_view_set_position(m_view, x, y);
@@ -561,6 +640,7 @@ public:
 
         if (pointer()->button_count == 0 && state == WL_POINTER_BUTTON_STATE_RELEASED) {
             shsurf->moveEndSignal(shsurf);
+            shsurf->saveGeometry();
             shsurf->m_runningGrab = nullptr;
             delete this;
         }
@@ -677,27 +757,38 @@ void ShellSurface::dragResize(weston_seat *ws, Edges edges)
  * Returns the bounding box of a surface and all its sub-surfaces,
  * in the surface coordinates system. */
 IRect2D ShellSurface::surfaceTreeBoundingBox() const {
-    pixman_region32_t region;
-    pixman_box32_t *box;
     struct weston_subsurface *subsurface;
+    bool empty = true;
+    int32_t x1 = 0, y1 = 0, x2 = 0, y2 = 0;
 
-    pixman_region32_init_rect(&region, 0, 0,
-                              m_surface->width,
-                              m_surface->height);
+    // Same as the extents of the union of the rects, but without
+    // allocating a pixman region every time. Empty rects don't count.
+    auto add = [&](int32_t x, int32_t y, int32_t w, int32_t h) {
+        if (w <= 0 || h <= 0) {
+            return;
+        }
+        if (empty) {
+            x1 = x; y1 = y; x2 = x + w; y2 = y + h;
+            empty = false;
+        } else {
+            x1 = std::min(x1, x);
+            y1 = std::min(y1, y);
+            x2 = std::max(x2, x + w);
+            y2 = std::max(y2, y + h);
+        }
+    };
 
+    add(0, 0, m_surface->width, m_surface->height);
     wl_list_for_each(subsurface, &m_surface->subsurface_list, parent_link) {
-        pixman_region32_union_rect(&region, &region,
-                                   subsurface->position.x,
-                                   subsurface->position.y,
-                                   subsurface->surface->width,
-                                   subsurface->surface->height);
+        // the list contains the parent surface itself too
+        if (subsurface->surface == m_surface) {
+            continue;
+        }
+        add(subsurface->position.x, subsurface->position.y,
+            subsurface->surface->width, subsurface->surface->height);
     }
 
-    box = pixman_region32_extents(&region);
-    IRect2D rect(box->x1, box->y1, box->x2 - box->x1, box->y2 - box->y1);
-    pixman_region32_fini(&region);
-
-    return rect;
+    return IRect2D(x1, y1, x2 - x1, y2 - y1);
 }
 
 void ShellSurface::setPopup(struct weston_surface *parent, weston_seat *seat, int32_t x, int32_t y, uint32_t serial)
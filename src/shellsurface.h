@@ -25,6 +25,7 @@
 #include "shellsignal.h"
 #include "utils.h"
 #include "interface.h"
+#include "framethrottle.h"
 
 struct weston_view;
 
@@ -87,6 +88,7 @@ public:
     inline struct wl_client *client() const { return wl_resource_get_client(m_surface->resource); }
     inline struct weston_surface *weston_surface() const { return m_surface; }
     inline weston_view *view() const { return m_view; }
+    inline FrameThrottle *frameThrottle() { return &m_frameThrottle; }
 
     inline Type type() const { return m_type; }
     bool isMapped() const;
@@ -98,6 +100,7 @@ public:
     float transformedY() const;
     int32_t transformedWidth() const;
     int32_t transformedHeight() const;
+    IRect2D transformedRect() const;
     void setPosition(float x, float y);
     IRect2D surfaceTreeBoundingBox() const;
     float alpha() const;
@@ -146,6 +149,8 @@ public:
     Signal<> activeChangedSignal;
     Signal<> mappedSignal;
     Signal<> unmappedSignal;
+    Signal<> workspaceChangedSignal;
+    Signal<> committedSignal;
 
 private:
     void internalUnsetFullscreen();
@@ -156,12 +161,15 @@ private:
     void destroy(void *data);
     void savePos();
     void restorePos();
+    void applyCachedGeometry();
+    void saveGeometry();
 
     Shell *m_shell;
     Workspace *m_workspace;
     struct weston_surface *m_surface;
     weston_view *m_view;
     WlListener m_surfaceDestroyListener;
+    FrameThrottle m_frameThrottle;
     Type m_type;
     const struct weston_shell_client *m_client;
     std::string m_title;
@@ -171,6 +179,10 @@ private:
     int32_t m_savedWidth, m_savedHeight;
     bool m_savedPos;
     bool m_savedSize;
+    // where the geometry cache puts the window when it is first mapped
+    int32_t m_cachedX, m_cachedY;
+    bool m_hasCachedPos;
+    bool m_geometryApplied;
     bool m_acceptState;
     ShellGrab *m_runningGrab;
     int32_t m_lastWidth, m_lastHeight;
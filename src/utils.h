@@ -21,36 +21,12 @@
 #include <weston/compositor.h>
 
 #include "shellsignal.h"
+#include "geometry2d.h"
 
 #define container_of(ptr, type, member) ({				\
 	const __typeof__( ((type *)0)->member ) *__mptr = (ptr);	\
 	(type *)( (char *)__mptr - offsetof(type,member) );})
 
-template<typename T>
-class Vector2D {
-public:
-    inline Vector2D(T a, T b) : x(a), y(b) {}
-    T x;
-    T y;
-};
-
-template<typename T>
-class Rect2D {
-public:
-    inline Rect2D(T a, T b, T w, T h) : x(a), y(b), width(w), height(h) {}
-    T x;
-    T y;
-    T width;
-    T height;
-
-    bool contains(T a, T b) const { return a >= x && a <= x + width && b >= y && b <= y + height; }
-
-    bool operator==(const Rect2D &r) { return x == r.x && y == r.y && width == r.width && height == r.height; }
-    bool operator!=(const Rect2D &r) { return !(*this == r); }
-};
-
-typedef Vector2D<int> IVector2D;
-typedef Rect2D<int> IRect2D;
 
 class WlListener {
 public:
@@ -114,6 +90,9 @@ public:
     void start();
     void stop();
     bool isRunning() const;
+    // takes effect the next time the timer is started
+    void setInterval(int interval) { m_interval = interval; }
+    inline int interval() const { return m_interval; }
 
     Signal<> triggered;
 
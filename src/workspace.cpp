@@ -15,10 +15,13 @@
  * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <vector>
+
 #include "workspace.h"
 #include "shell.h"
 #include "shellsurface.h"
 #include "utils.h"
+#include "workspacedamage.h"
 
 Workspace::Workspace(Shell *shell, int number)
          : m_shell(shell)
@@ -112,7 +115,10 @@ void Workspace::addSurface(ShellSurface *surface)
         weston_view_set_transform_parent(surface->view(), m_rootSurface);
     }
     m_layer.addSurface(surface);
-    surface->m_workspace = this;
+    if (surface->m_workspace != this) {
+        surface->m_workspace = this;
+        surface->workspaceChangedSignal();
+    }
 }
 
 void Workspace::removeSurface(ShellSurface *surface)
@@ -166,25 +172,92 @@ struct weston_output *Workspace::output() const
 
 void Workspace::insert(Workspace *ws)
 {
-    m_layer.insert(&ws->m_layer);
-    m_backgroundLayer.insert(&m_layer);
+    m_layer.insert(&ws->m_layer, false);
+    m_backgroundLayer.insert(&m_layer, false);
+    damage(true);
 }
 
 void Workspace::insert(Layer *layer)
 {
-    m_layer.insert(layer);
-    m_backgroundLayer.insert(&m_layer);
+    m_layer.insert(layer, false);
+    m_backgroundLayer.insert(&m_layer, false);
+    damage(true);
 }
 
 void Workspace::insert(struct weston_layer *layer)
 {
-    m_layer.insert(layer);
-    m_backgroundLayer.insert(&m_layer);
+    m_layer.insert(layer, false);
+    m_backgroundLayer.insert(&m_layer, false);
+    damage(true);
 }
 
 void Workspace::remove()
 {
-    m_layer.remove();
+    damage(false);
+    m_layer.remove(false);
+}
+
+/*
+ * Damage the area covered by the workspace at once instead of each view
+ * on its own. When the backgrounds are included the outputs they cover, as
+ * they normally do, are damaged as a whole without looking at the windows.
+ */
+void Workspace::damage(bool backgrounds)
+{
+    weston_compositor *compositor = m_shell->compositor();
+    std::vector<weston_output *> partialOutputs;
+
+    weston_output *output;
+    wl_list_for_each(output, &compositor->output_list, link) {
+        if (backgrounds && m_outputs.count(output) && m_outputs.at(output)->background) {
+            weston_view *bg = m_outputs.at(output)->background;
+            if (bg->transform.dirty) {
+                weston_view_update_transform(bg);
+            }
+            pixman_box32_t box = { output->x, output->y, output->x + output->width, output->y + output->height };
+            if (pixman_region32_contains_rectangle(&bg->transform.boundingbox, &box) == PIXMAN_REGION_IN) {
+                weston_output_damage(output);
+                continue;
+            }
+        }
+        partialOutputs.push_back(output);
+    }
+    if (partialOutputs.empty()) {
+        return;
+    }
+
+    WorkspaceDamage area;
+    auto add = [&area](weston_view *view) {
+        if (view->transform.dirty) {
+            weston_view_update_transform(view);
+        }
+        area.addBox(*pixman_region32_extents(&view->transform.boundingbox));
+    };
+    for (weston_view *view: m_layer) {
+        add(view);
+    }
+    if (backgrounds) {
+        for (weston_view *view: m_backgroundLayer) {
+            add(view);
+        }
+    }
+
+    pixman_region32_t partial;
+    pixman_region32_init(&partial);
+    for (weston_output *output: partialOutputs) {
+        switch (area.forOutput(&output->region, &partial)) {
+            case WorkspaceDamage::Output::Whole:
+                weston_output_damage(output);
+                break;
+            case WorkspaceDamage::Output::Partial:
+                pixman_region32_union(&compositor->primary_plane.damage, &compositor->primary_plane.damage, &partial);
+                weston_output_schedule_repaint(output);
+                break;
+            case WorkspaceDamage::Output::None:
+                break;
+        }
+    }
+    pixman_region32_fini(&partial);
 }
 
 void Workspace::setActive(bool active)
@@ -65,6 +65,7 @@ public:
 
 private:
     void backgroundDestroyed(void *d);
+    void damage(bool backgrounds);
 
     struct Output {
         weston_view *background;
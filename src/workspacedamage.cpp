@@ -0,0 +1,56 @@
+/*
+ * Copyright 2014  Giulio Camuffo <giuliocamuffo@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "workspacedamage.h"
+
+WorkspaceDamage::WorkspaceDamage()
+               : m_dirty(false)
+{
+    pixman_region32_init(&m_region);
+}
+
+WorkspaceDamage::~WorkspaceDamage()
+{
+    pixman_region32_fini(&m_region);
+}
+
+void WorkspaceDamage::addBox(const pixman_box32_t &box)
+{
+    if (box.x1 < box.x2 && box.y1 < box.y2) {
+        m_boxes.push_back(box);
+        m_dirty = true;
+    }
+}
+
+WorkspaceDamage::Output WorkspaceDamage::forOutput(pixman_region32_t *output, pixman_region32_t *partial)
+{
+    if (m_dirty) {
+        pixman_region32_fini(&m_region);
+        pixman_region32_init_rects(&m_region, m_boxes.data(), m_boxes.size());
+        m_dirty = false;
+    }
+
+    pixman_region32_intersect(partial, &m_region, output);
+    if (!pixman_region32_not_empty(partial)) {
+        return Output::None;
+    }
+    if (pixman_region32_equal(partial, output)) {
+        return Output::Whole;
+    }
+    return Output::Partial;
+}
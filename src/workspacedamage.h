@@ -0,0 +1,53 @@
+/*
+ * Copyright 2014  Giulio Camuffo <giuliocamuffo@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef WORKSPACEDAMAGE_H
+#define WORKSPACEDAMAGE_H
+
+#include <vector>
+
+#include <pixman.h>
+
+/*
+ * Collects the boxes of the views of a workspace and works out, per output,
+ * whether it needs to be damaged whole or only partly. The boxes are merged
+ * into a region at once when first needed, instead of one union per view.
+ */
+class WorkspaceDamage
+{
+public:
+    enum class Output {
+        None,
+        Whole,
+        Partial
+    };
+
+    WorkspaceDamage();
+    ~WorkspaceDamage();
+
+    void addBox(const pixman_box32_t &box);
+    // When it returns Output::Partial, partial holds the damage on the output
+    Output forOutput(pixman_region32_t *output, pixman_region32_t *partial);
+
+private:
+    std::vector<pixman_box32_t> m_boxes;
+    pixman_region32_t m_region;
+    bool m_dirty;
+};
+
+#endif
@@ -115,7 +115,7 @@ void XdgShell::pointerFocus(ShellSeat *, weston_pointer *pointer)
 {
     weston_view *view = pointer->focus;
 
-    if (!view)
+    if (!view || Shell::instance()->isInGameMode())
         return;
 
     ShellSurface *shsurf = Shell::getShellSurface(view->surface);